@@ -0,0 +1,271 @@
+#include "data_source.hpp"
+#include "yahoo_parser.hpp"
+#include <atomic>
+#include <thread>
+#include <filesystem>
+#include <exception>
+#include <stdexcept>
+#include <algorithm>
+#include <cstdio>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+namespace portfolio_optimizer::data
+{
+    namespace
+    {
+        constexpr size_t read_block_size = 1 << 20;
+        // Smaller files are read with pread into the thread's buffer. Mapping them costs more than the copy: every
+        // munmap shoots down the TLB entries of all the pool's threads.
+        constexpr size_t map_threshold = 4 * read_block_size;
+        // Average Yahoo row is a bit over 64 bytes, so this never under-reserves by much
+        constexpr size_t bytes_per_row = 64;
+        SchedulerOptions verbose_options(const bool verbose)
+        {
+            SchedulerOptions options;
+            options.download.verbose = verbose;
+            return options;
+        }
+        std::vector<char> &read_buffer()
+        {
+            thread_local std::vector<char> buffer(read_block_size);
+            return buffer;
+        }
+        bool parse_buffered(const std::string &path, YahooCsvParser &parser)
+        {
+            std::FILE *file = std::fopen(path.c_str(), "rb");
+            if (file == nullptr)
+            {
+                return false;
+            }
+            std::vector<char> &buffer = read_buffer();
+            size_t read;
+            while ((read = std::fread(buffer.data(), 1, buffer.size(), file)) > 0)
+            {
+                parser.feed(buffer.data(), read);
+            }
+            std::fclose(file);
+            return true;
+        }
+#ifndef _WIN32
+        // Fails part way only on a read error, the rows before it have been fed by then
+        bool parse_read(int fd, YahooCsvParser &parser)
+        {
+            std::vector<char> &buffer = read_buffer();
+            off_t offset = 0;
+            while (true)
+            {
+                ssize_t read = pread(fd, buffer.data(), buffer.size(), offset);
+                if (read < 0)
+                {
+                    return false;
+                }
+                if (read == 0)
+                {
+                    return true;
+                }
+                parser.feed(buffer.data(), static_cast<size_t>(read));
+                offset += read;
+            }
+        }
+        bool parse_mapped(int fd, size_t size, YahooCsvParser &parser)
+        {
+            void *mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (mapped == MAP_FAILED)
+            {
+                return false;
+            }
+            madvise(mapped, size, MADV_SEQUENTIAL);
+            parser.feed(static_cast<const char *>(mapped), size);
+            munmap(mapped, size);
+            return true;
+        }
+#endif
+    }
+    YahooStockData load_csv_file(const std::string &path, const std::string &symbol, const std::time_t &start, const std::time_t &end)
+    {
+        YahooStockData result;
+        result.symbol = symbol;
+        YahooCsvParser parser(result, start, end);
+#ifdef _WIN32
+        std::error_code error;
+        size_t size = std::filesystem::file_size(path, error);
+        if (!error)
+        {
+            result.reserve(size / bytes_per_row);
+        }
+        if (!parse_buffered(path, parser))
+        {
+            throw std::runtime_error("Failed to open " + path);
+        }
+#else
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+        {
+            throw std::runtime_error("Failed to open " + path);
+        }
+        struct stat info;
+        bool parsed = false;
+        if (fstat(fd, &info) == 0 && info.st_size > 0)
+        {
+            const size_t size = static_cast<size_t>(info.st_size);
+            result.reserve(size / bytes_per_row);
+            if (size >= map_threshold)
+            {
+                parsed = parse_mapped(fd, size, parser);
+            }
+            else if (!parse_read(fd, parser))
+            {
+                close(fd);
+                throw std::runtime_error("Failed to read " + path);
+            }
+            else
+            {
+                parsed = true;
+            }
+        }
+        close(fd);
+        if (!parsed && !parse_buffered(path, parser))
+        {
+            throw std::runtime_error("Failed to read " + path);
+        }
+#endif
+        parser.finish();
+        return result;
+    }
+    void DataSource::stream(const std::vector<std::string> &symbols, const std::time_t &start, const std::time_t &end,
+                            const Arrival &on_arrival, size_t threads)
+    {
+        if (threads == 0)
+        {
+            threads = std::max<size_t>(1, std::thread::hardware_concurrency());
+        }
+        threads = std::max<size_t>(1, std::min(threads, symbols.size()));
+        std::vector<std::exception_ptr> errors(symbols.size());
+        std::atomic<size_t> next = 0;
+        std::vector<std::thread> workers(threads);
+        for (size_t t = 0; t < threads; t++)
+        {
+            workers[t] = std::thread([&]()
+            {
+                for (size_t i = next++; i < symbols.size(); i = next++)
+                {
+                    try
+                    {
+                        YahooStockData data = load(symbols[i], start, end);
+                        on_arrival(i, data);
+                    }
+                    catch (...)
+                    {
+                        errors[i] = std::current_exception();
+                    }
+                }
+            });
+        }
+        for (size_t t = 0; t < threads; t++)
+        {
+            workers[t].join();
+        }
+        for (size_t i = 0; i < errors.size(); i++)
+        {
+            if (errors[i])
+            {
+                std::rethrow_exception(errors[i]);
+            }
+        }
+    }
+    std::vector<YahooStockData> DataSource::load(const std::vector<std::string> &symbols, const std::time_t &start, const std::time_t &end,
+                                                 size_t threads)
+    {
+        std::vector<YahooStockData> result(symbols.size());
+        stream(symbols, start, end, [&](size_t index, YahooStockData &data)
+               { result[index] = std::move(data); }, threads);
+        return result;
+    }
+    ReturnsPanel DataSource::load_returns(const std::vector<std::string> &symbols, const std::vector<YahooStockData::ReturnColumn> &columns,
+                                          const std::time_t &start, const std::time_t &end, ReturnType type, ReturnFrequency frequency,
+                                          size_t threads)
+    {
+        std::vector<YahooStockData> data = load(symbols, start, end, threads);
+        align(data);
+        return compute_returns(data, columns, type, frequency, threads);
+    }
+    YahooDataSource::YahooDataSource(const bool verbose) : YahooDataSource(verbose_options(verbose))
+    {
+    }
+    YahooDataSource::YahooDataSource(const SchedulerOptions &options) : options(options), scheduler(options)
+    {
+    }
+    YahooStockData YahooDataSource::load(const std::string &symbol, const std::time_t &start, const std::time_t &end)
+    {
+        return download_yahoo_data(symbol, start, end, options.download);
+    }
+    void YahooDataSource::stream(const std::vector<std::string> &symbols, const std::time_t &start, const std::time_t &end,
+                                 const Arrival &on_arrival, size_t)
+    {
+        std::vector<DownloadJob> jobs(symbols.size());
+        for (size_t i = 0; i < symbols.size(); i++)
+        {
+            jobs[i].symbol = symbols[i];
+            jobs[i].start = start;
+            jobs[i].end = end;
+        }
+        std::vector<std::exception_ptr> errors(symbols.size());
+        std::vector<DownloadResult> downloaded = scheduler.run(jobs, [&](size_t index, DownloadResult &result)
+        {
+            if (!result.success)
+            {
+                return;
+            }
+            try
+            {
+                on_arrival(index, result.data);
+            }
+            catch (...)
+            {
+                errors[index] = std::current_exception();
+            }
+        });
+        for (size_t i = 0; i < downloaded.size(); i++)
+        {
+            if (!downloaded[i].success)
+            {
+                const DownloadResult &failed = downloaded[i];
+                throw DownloadError(failed.symbol + ": " + failed.error, failed.http_code, failed.curl_code, failed.retry_after);
+            }
+            if (errors[i])
+            {
+                std::rethrow_exception(errors[i]);
+            }
+        }
+    }
+    std::vector<HostMetrics> YahooDataSource::metrics()
+    {
+        return scheduler.metrics();
+    }
+    CsvDirectoryDataSource::CsvDirectoryDataSource(const std::string &directory, const std::string &extension)
+    {
+        this->directory = directory;
+        this->extension = extension;
+    }
+    YahooStockData CsvDirectoryDataSource::load(const std::string &symbol, const std::time_t &start, const std::time_t &end)
+    {
+        return load_csv_file((std::filesystem::path(directory) / (symbol + extension)).string(), symbol, start, end);
+    }
+    std::vector<std::string> CsvDirectoryDataSource::symbols() const
+    {
+        std::vector<std::string> result;
+        for (const auto &entry : std::filesystem::directory_iterator(directory))
+        {
+            if (entry.is_regular_file() && entry.path().extension() == extension)
+            {
+                result.push_back(entry.path().stem().string());
+            }
+        }
+        std::sort(result.begin(), result.end());
+        return result;
+    }
+}
@@ -0,0 +1,64 @@
+#pragma once
+#include "download_data.hpp"
+#include "returns.hpp"
+#include "download_scheduler.hpp"
+#include <vector>
+#include <string>
+#include <ctime>
+#include <limits>
+#include <functional>
+namespace portfolio_optimizer::data
+{
+    class DataSource
+    {
+    public:
+        virtual ~DataSource() = default;
+        typedef std::function<void(size_t index, YahooStockData &data)> Arrival;
+        virtual YahooStockData load(const std::string &symbol, const std::time_t &start, const std::time_t &end) = 0;
+        // Loads every symbol in parallel and hands each one to on_arrival (which may move it out) as soon as it is parsed.
+        // on_arrival can run concurrently from several workers. Throws the first failure once every symbol has been attempted.
+        // threads = 0 uses every hardware thread
+        virtual void stream(const std::vector<std::string> &symbols, const std::time_t &start, const std::time_t &end,
+                            const Arrival &on_arrival, size_t threads = 0);
+        // Loads every symbol in parallel, threads = 0 uses every hardware thread
+        std::vector<YahooStockData> load(const std::vector<std::string> &symbols, const std::time_t &start, const std::time_t &end,
+                                         size_t threads = 0);
+        // Loads the symbols, keeps only the dates every one of them traded and computes their returns
+        ReturnsPanel load_returns(const std::vector<std::string> &symbols, const std::vector<YahooStockData::ReturnColumn> &columns,
+                                  const std::time_t &start, const std::time_t &end, ReturnType type = ReturnType::Simple,
+                                  ReturnFrequency frequency = ReturnFrequency::Daily, size_t threads = 0);
+    };
+    class YahooDataSource : public DataSource
+    {
+    public:
+        YahooDataSource(const bool verbose = false);
+        YahooDataSource(const SchedulerOptions &options);
+        using DataSource::load;
+        YahooStockData load(const std::string &symbol, const std::time_t &start, const std::time_t &end) override;
+        // Network bound, so concurrency is tuned by the DownloadScheduler instead of threads.
+        // Throws the first DownloadError once every symbol has been attempted.
+        void stream(const std::vector<std::string> &symbols, const std::time_t &start, const std::time_t &end,
+                    const Arrival &on_arrival, size_t threads = 0) override;
+        std::vector<HostMetrics> metrics();
+
+    private:
+        SchedulerOptions options;
+        DownloadScheduler scheduler;
+    };
+    // Reads Yahoo-format CSVs named <symbol><extension> from a local directory
+    class CsvDirectoryDataSource : public DataSource
+    {
+    public:
+        CsvDirectoryDataSource(const std::string &directory, const std::string &extension = ".csv");
+        using DataSource::load;
+        YahooStockData load(const std::string &symbol, const std::time_t &start, const std::time_t &end) override;
+        std::vector<std::string> symbols() const;
+
+    private:
+        std::string directory;
+        std::string extension;
+    };
+    YahooStockData load_csv_file(const std::string &path, const std::string &symbol,
+                                 const std::time_t &start = std::numeric_limits<std::time_t>::min(),
+                                 const std::time_t &end = std::numeric_limits<std::time_t>::max());
+}
@@ -4,6 +4,38 @@
 #include <iomanip>
 namespace portfolio_optimizer::data
 {
+    // std::localtime returns a shared static buffer, which must be neither freed nor shared across threads
+    std::tm local_time(const std::time_t &time)
+    {
+        std::tm tm = {};
+#ifdef _WIN32
+        localtime_s(&tm, &time);
+#else
+        localtime_r(&time, &tm);
+#endif
+        return tm;
+    }
+    int64_t days_from_civil(int64_t year, unsigned month, unsigned day)
+    {
+        year -= month <= 2;
+        const int64_t era = (year >= 0 ? year : year - 399) / 400;
+        const unsigned yoe = static_cast<unsigned>(year - era * 400);
+        const unsigned doy = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + day - 1;
+        const unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+        return era * 146097 + static_cast<int64_t>(doe) - 719468;
+    }
+    int64_t local_day(const std::time_t &time)
+    {
+        std::tm tm = local_time(time);
+        return days_from_civil(tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday);
+    }
+    int64_t utc_offset(const std::time_t &time)
+    {
+        std::tm tm = local_time(time);
+        int64_t local = days_from_civil(tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday) * 86400 + tm.tm_hour * 3600 +
+                        tm.tm_min * 60 + tm.tm_sec;
+        return local - static_cast<int64_t>(time);
+    }
     datetime::datetime()
     {
         time = std::nullopt;
@@ -62,15 +94,9 @@ namespace portfolio_optimizer::data
         if (time.has_value())
         {
             std::time_t t = time.value();
-            std::tm *tm = new std::tm();
-#ifdef _WIN32
-            localtime_s(tm, &t);
-#else
-            tm = std::localtime(&t);
-#endif
+            std::tm tm = local_time(t);
             char buffer[80];
-            std::strftime(buffer, sizeof(buffer), format.c_str(), tm);
-            delete tm;
+            std::strftime(buffer, sizeof(buffer), format.c_str(), &tm);
             return std::string(buffer);
         }
         else if (time_string.has_value())
@@ -87,15 +113,9 @@ namespace portfolio_optimizer::data
         if (time.has_value())
         {
             std::time_t t = time.value();
-            std::tm *tm = new std::tm();
-#ifdef _WIN32
-            localtime_s(tm, &(time.value()));
-#else
-            tm = std::localtime(&(time.value()));
-#endif
+            std::tm tm = local_time(t);
             char buf[80];
-            std::strftime(buf, sizeof(buf), format, tm);
-            delete tm;
+            std::strftime(buf, sizeof(buf), format, &tm);
             return std::string(buf);
         }
         else if (time_string.has_value())
@@ -109,41 +129,23 @@ namespace portfolio_optimizer::data
     }
     std::string datetime::to_string(const std::time_t &time)
     {
-        std::tm *tm = new std::tm();
-#ifdef _WIN32
-        localtime_s(tm, &time);
-#else
-        tm = std::localtime(&time);
-#endif
+        std::tm tm = local_time(time);
         char buf[80];
-        std::strftime(buf, sizeof(buf), "%Y-%m-%d", tm);
-        delete tm;
+        std::strftime(buf, sizeof(buf), "%Y-%m-%d", &tm);
         return std::string(buf);
     }
     std::string datetime::to_string(const std::time_t &time, const std::string &format)
     {
-        std::tm *tm = new std::tm();
-#ifdef _WIN32
-        localtime_s(tm, &time);
-#else
-        tm = std::localtime(&time);
-#endif
-        std::unique_ptr<char[]> buf(new char[format.length() + 1]);
-        std::strftime(buf.get(), sizeof(buf.get()), format.c_str(), tm);
-        delete tm;
-        return std::string(buf.get());
+        std::tm tm = local_time(time);
+        char buf[256];
+        std::strftime(buf, sizeof(buf), format.c_str(), &tm);
+        return std::string(buf);
     }
     std::string datetime::to_string(const std::time_t &time, const char *format)
     {
-        std::tm *tm = new std::tm();
-#ifdef _WIN32
-        localtime_s(tm, &time);
-#else
-        tm = std::localtime(&time);
-#endif
+        std::tm tm = local_time(time);
         char buf[80];
-        std::strftime(buf, sizeof(buf), format, tm);
-        delete tm;
+        std::strftime(buf, sizeof(buf), format, &tm);
         return std::string(buf);
     }
     std::string datetime::to_string()
@@ -151,15 +153,9 @@ namespace portfolio_optimizer::data
         if (time.has_value())
         {
             std::time_t t = time.value();
-            std::tm *tm = new std::tm();
-#ifdef _WIN32
-            localtime_s(tm, &t);
-#else
-            tm = std::localtime(&t);
-#endif
+            std::tm tm = local_time(t);
             char buf[80];
-            std::strftime(buf, sizeof(buf), "%Y-%m-%d", tm);
-            delete tm;
+            std::strftime(buf, sizeof(buf), "%Y-%m-%d", &tm);
             return std::string(buf);
         }
         else if (time_string.has_value())
@@ -179,19 +175,14 @@ namespace portfolio_optimizer::data
                                    const int &months, const int &days, const int &hours,
                                    const int &minutes, const int &seconds)
     {
-        std::tm *tm = new std::tm();
-#ifdef _WIN32
-        localtime_s(tm, &time);
-#else
-        tm = std::localtime(&time);
-#endif
-        tm->tm_year += years;
-        tm->tm_mon += months;
-        tm->tm_mday += days;
-        tm->tm_hour += hours;
-        tm->tm_min += minutes;
-        tm->tm_sec += seconds;
-        return std::mktime(tm);
+        std::tm tm = local_time(time);
+        tm.tm_year += years;
+        tm.tm_mon += months;
+        tm.tm_mday += days;
+        tm.tm_hour += hours;
+        tm.tm_min += minutes;
+        tm.tm_sec += seconds;
+        return std::mktime(&tm);
     }
     int64_t datetime::to_numeric()
     {
@@ -1,9 +1,18 @@
 #pragma once
 #include <ctime>
+#include <cstdint>
 #include <string>
 #include <optional>
 namespace portfolio_optimizer::data
 {
+    // Calendar fields of time in the local time zone, safe to call from any thread
+    std::tm local_time(const std::time_t &time);
+    // Days since 1970-01-01 of a proleptic Gregorian date
+    int64_t days_from_civil(int64_t year, unsigned month, unsigned day);
+    // Days since 1970-01-01 of the local calendar date of time
+    int64_t local_day(const std::time_t &time);
+    // Seconds the local time zone is ahead of UTC at time
+    int64_t utc_offset(const std::time_t &time);
     class datetime
     {
     public:
@@ -1,57 +1,94 @@
 #include "download_data.hpp"
+#include "yahoo_parser.hpp"
+#include "returns.hpp"
 #include <curl/curl.h>
 #include <string>
 #include <iostream>
-#include <sstream>
+#include <stdexcept>
+#include <charconv>
+#include <cctype>
+#include <mutex>
+#include <thread>
+#include <exception>
+#include <algorithm>
 #ifdef _WIN32
 #include <format>
 #else
 #include <fmt/format.h>
 #endif
 #include <vector>
+#include <limits>
 namespace portfolio_optimizer::data
 {
-    std::vector<double> YahooStockData::get_return(ReturnColumn column)
+    const char *interval_name(BarInterval interval)
     {
-        std::vector<double> result;
-        result.reserve(date.size());
-        for (int i = 1; i < date.size(); i++)
+        switch (interval)
         {
-            double r = 0;
-            switch (column)
-            {
-            case ReturnColumn::Open:
-                r = (open[i] - open[i - 1]) / open[i - 1];
-                break;
-            case ReturnColumn::High:
-                r = (high[i] - high[i - 1]) / high[i - 1];
-                break;
-            case ReturnColumn::Low:
-                r = (low[i] - low[i - 1]) / low[i - 1];
-                break;
-            case ReturnColumn::Close:
-                r = (close[i] - close[i - 1]) / close[i - 1];
-                break;
-            case ReturnColumn::AdjClose:
-                r = (adj_close[i] - adj_close[i - 1]) / adj_close[i - 1];
-                break;
-            case ReturnColumn::Volume:
-                r = (volume[i] - volume[i - 1]) / volume[i - 1];
-                break;
-            }
-            result.push_back(r);
+        case BarInterval::OneMinute:
+            return "1m";
+        case BarInterval::FiveMinutes:
+            return "5m";
+        case BarInterval::OneHour:
+            return "1h";
+        case BarInterval::OneDay:
+            return "1d";
+        }
+        throw std::invalid_argument("Unknown bar interval");
+    }
+    std::time_t interval_seconds(BarInterval interval)
+    {
+        switch (interval)
+        {
+        case BarInterval::OneMinute:
+            return 60;
+        case BarInterval::FiveMinutes:
+            return 300;
+        case BarInterval::OneHour:
+            return 3600;
+        case BarInterval::OneDay:
+            return 86400;
+        }
+        throw std::invalid_argument("Unknown bar interval");
+    }
+    size_t expected_bars(const std::time_t &start, const std::time_t &end, BarInterval interval)
+    {
+        if (end < start)
+        {
+            return 0;
+        }
+        const int64_t first = local_day(start);
+        const int64_t days = local_day(end) - first + 1;
+        if (interval == BarInterval::OneDay)
+        {
+            return static_cast<size_t>(days);
+        }
+        // 1970-01-01 was a Thursday, so day 4 is a Monday
+        int64_t weekdays = days / 7 * 5;
+        for (int64_t day = first + days / 7 * 7; day < first + days; day++)
+        {
+            int64_t weekday = ((day - 4) % 7 + 7) % 7;
+            weekdays += weekday < 5;
         }
+        constexpr std::time_t session_seconds = 23400;
+        const std::time_t seconds = interval_seconds(interval);
+        return static_cast<size_t>(weekdays) * static_cast<size_t>((session_seconds + seconds - 1) / seconds);
+    }
+    std::vector<double> YahooStockData::get_return(ReturnColumn column)
+    {
+        std::vector<double> result(date.size() > 1 ? date.size() - 1 : 0);
+        compute_returns(this->column(column).data(), date.size(), result.data(), ReturnType::Simple, periods_per_year(ReturnFrequency::Daily));
         return result;
     }
     std::string YahooStockData::to_string()
     {
         std::string result;
-        for (int i = 0; i < date.size(); i++)
+        const char *format = interval == BarInterval::OneDay ? "%Y-%m-%d" : "%Y-%m-%d %H:%M:%S";
+        for (size_t i = 0; i < date.size(); i++)
         {
 #ifdef _WIN32
-            result += std::format("{} {} {} {} {} {} {} {}\n", symbol, date_util.to_string(date[i]), open[i], high[i], low[i], close[i], adj_close[i], volume[i]);
+            result += std::format("{} {} {} {} {} {} {} {}\n", symbol, date_util.to_string(date[i], format), open[i], high[i], low[i], close[i], adj_close[i], volume[i]);
 #else
-            result += fmt::format("{} {} {} {} {} {} {} {}\n", symbol, date_util.to_string(date[i]), open[i], high[i], low[i], close[i], adj_close[i], volume[i]);
+            result += fmt::format("{} {} {} {} {} {} {} {}\n", symbol, date_util.to_string(date[i], format), open[i], high[i], low[i], close[i], adj_close[i], volume[i]);
 #endif
         }
         return result;
@@ -66,105 +103,241 @@ namespace portfolio_optimizer::data
         adj_close.reserve(size);
         volume.reserve(size);
     }
-    double fast_stod(const std::string &str)
+    struct DownloadContext
     {
-        const char *p = str.c_str();
-        double r = 0.0;
-        bool neg = false;
-        if (*p == '-')
-        {
-            neg = true;
-            ++p;
-        }
-        while (*p >= '0' && *p <= '9')
+        CURL *curl;
+        YahooCsvParser parser;
+        long http_code = 0;
+        double retry_after = 0;
+        // Thrown while parsing, the transfer is aborted and it is rethrown after curl_easy_perform
+        std::exception_ptr error = nullptr;
+    };
+    size_t WriteCallback(char *contents, size_t size, size_t nmemb, DownloadContext *context)
+    {
+        if (context->http_code == 0)
         {
-            r = (r * 10.0) + (*p - '0');
-            ++p;
+            curl_easy_getinfo(context->curl, CURLINFO_RESPONSE_CODE, &context->http_code);
         }
-        if (*p == '.')
+        if (context->http_code == 200)
         {
-            double f = 0.0;
-            int n = 0;
-            ++p;
-            while (*p >= '0' && *p <= '9')
+            try
+            {
+                context->parser.feed(contents, size * nmemb);
+            }
+            catch (...)
             {
-                f = (f * 10.0) + (*p - '0');
-                ++p;
-                ++n;
+                context->error = std::current_exception();
+                return 0;
             }
-            r += f / std::pow(10.0, n);
         }
-        if (neg)
+        return size * nmemb;
+    }
+    size_t HeaderCallback(char *contents, size_t size, size_t nmemb, DownloadContext *context)
+    {
+        const size_t length = size * nmemb;
+        constexpr char name[] = "retry-after:";
+        constexpr size_t name_length = sizeof(name) - 1;
+        if (length > name_length)
         {
-            r = -r;
+            for (size_t i = 0; i < name_length; i++)
+            {
+                if (std::tolower(static_cast<unsigned char>(contents[i])) != name[i])
+                {
+                    return length;
+                }
+            }
+            const char *p = contents + name_length;
+            const char *end = contents + length;
+            while (p < end && *p == ' ')
+            {
+                p++;
+            }
+            double seconds = 0;
+            if (std::from_chars(p, end, seconds).ec == std::errc())
+            {
+                context->retry_after = seconds;
+            }
         }
-        return r;
+        return length;
     }
-    size_t WriteCallback(char *contents, size_t size, size_t nmemb, std::string *userp)
+    YahooStockData download_yahoo_data(const std::string &symbol, const std::time_t &start, const std::time_t &end, const bool verbose)
     {
-        userp->append(contents, size * nmemb);
-        return size * nmemb;
+        DownloadOptions options;
+        options.verbose = verbose;
+        return download_yahoo_data(symbol, start, end, options);
     }
-    YahooStockData download_yahoo_data(const std::string &symbol, const std::time_t &start, const std::time_t &end, const bool verbose)
+    namespace
     {
-        std::string readBuffer;
-        CURL *curl = curl_easy_init();
-        if (curl)
+        std::time_t default_chunk_seconds(BarInterval interval)
         {
+            switch (interval)
+            {
+            case BarInterval::OneMinute:
+                return 7 * 86400;
+            case BarInterval::FiveMinutes:
+                return 30 * 86400;
+            case BarInterval::OneHour:
+                return 180 * 86400;
+            default:
+                return 0;
+            }
+        }
+        // One request for [start, end]. Rows are appended to result, those outside [first, last] are dropped.
+        void download_range(const std::string &symbol, const std::time_t &start, const std::time_t &end, const std::time_t &first, const std::time_t &last,
+                            const DownloadOptions &options, YahooStockData &result)
+        {
+            CURL *curl = curl_easy_init();
+            if (!curl)
+            {
+                throw DownloadError("curl_easy_init() failed for " + symbol, 0, static_cast<int>(CURLE_FAILED_INIT), 0);
+            }
+            DownloadContext context{curl, YahooCsvParser(result, first, last)};
             CURLcode res;
 #ifdef _WIN32
-            std::string url_formatted = std::format("https://query1.finance.yahoo.com/v7/finance/download/{}?period1={}&period2={}&interval=1d&events=history&includeAdjustedClose=true", symbol, start, end);
+            std::string url_formatted = std::format("{}/v7/finance/download/{}?period1={}&period2={}&interval={}&events=history&includeAdjustedClose=true", options.host, symbol, start, end, interval_name(options.interval));
 #else
-            std::string url_formatted = fmt::format("https://query1.finance.yahoo.com/v7/finance/download/{}?period1={}&period2={}&interval=1d&events=history&includeAdjustedClose=true", symbol, start, end);
+            std::string url_formatted = fmt::format("{}/v7/finance/download/{}?period1={}&period2={}&interval={}&events=history&includeAdjustedClose=true", options.host, symbol, start, end, interval_name(options.interval));
 #endif
             curl_easy_setopt(curl, CURLOPT_URL, url_formatted.c_str());
             curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, &WriteCallback);
-            curl_easy_setopt(curl, CURLOPT_WRITEDATA, &readBuffer);
+            curl_easy_setopt(curl, CURLOPT_WRITEDATA, &context);
+            curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, &HeaderCallback);
+            curl_easy_setopt(curl, CURLOPT_HEADERDATA, &context);
+            curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L);
+            if (options.timeout_ms > 0)
+            {
+                curl_easy_setopt(curl, CURLOPT_TIMEOUT_MS, options.timeout_ms);
+            }
             res = curl_easy_perform(curl);
-            int http_code = 0;
+            long http_code = 0;
             curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &http_code);
+            curl_easy_cleanup(curl);
+            if (context.error)
+            {
+                std::rethrow_exception(context.error);
+            }
             if (res != CURLE_OK || http_code != 200)
             {
-                std::cout << "curl_easy_perform() failed: " << curl_easy_strerror(res) << "\n";
-                std::cout << "http_code: " << http_code << "\n";
-                std::cout << "url: " << url_formatted << "\n";
-                throw std::runtime_error("curl_easy_perform() failed");
+                if (options.verbose)
+                {
+                    std::cout << "curl_easy_perform() failed: " << curl_easy_strerror(res) << "\n";
+                    std::cout << "http_code: " << http_code << "\n";
+                    std::cout << "url: " << url_formatted << "\n";
+                }
+                throw DownloadError("curl_easy_perform() failed: " + std::string(curl_easy_strerror(res)) + ", http_code: " + std::to_string(http_code) + ", url: " + url_formatted,
+                                    http_code, static_cast<int>(res), context.retry_after);
             }
-            if (verbose)
+            context.parser.finish();
+            if (options.verbose)
             {
                 std::cout << "Downloaded data for " << symbol << " from " << date_util.to_string(start) << " to " << date_util.to_string(end) << "\n";
             }
-            curl_easy_cleanup(curl);
         }
+        template <typename T>
+        void append(std::vector<T> &destination, std::vector<T> &source)
+        {
+            destination.insert(destination.end(), source.begin(), source.end());
+            std::vector<T>().swap(source);
+        }
+        // Moves part onto the end of result and frees it
+        void append(YahooStockData &result, YahooStockData &part)
+        {
+            append(result.date, part.date);
+            append(result.open, part.open);
+            append(result.high, part.high);
+            append(result.low, part.low);
+            append(result.close, part.close);
+            append(result.adj_close, part.adj_close);
+            append(result.volume, part.volume);
+        }
+    }
+    YahooStockData download_yahoo_data(const std::string &symbol, const std::time_t &start, const std::time_t &end, const DownloadOptions &options)
+    {
         YahooStockData result;
-        result.reserve(std::count(readBuffer.begin(), readBuffer.end(), '\n'));
         result.symbol = symbol;
-        std::string line;
-        std::istringstream f(readBuffer);
-        int i = 0;
-        while (std::getline(f, line))
+        result.interval = options.interval;
+        result.reserve(expected_bars(start, end, options.interval));
+        const std::time_t chunk_seconds = options.chunk_seconds > 0 ? options.chunk_seconds : default_chunk_seconds(options.interval);
+        if (chunk_seconds == 0 || end - start <= chunk_seconds)
         {
-            if (i == 0)
+            download_range(symbol, start, end, std::numeric_limits<std::time_t>::min(), std::numeric_limits<std::time_t>::max(), options, result);
+            return result;
+        }
+        // Chunk i asks for [start + i * chunk_seconds, its end] and keeps the bars starting before the next chunk,
+        // so a bar on a boundary is kept once and stitching is a plain concatenation in chunk order.
+        // Chunks [0, merged) are in result. A chunk picked when every earlier one is merged is parsed straight into
+        // result; the others are parsed on the side and moved over, freeing their columns, as soon as the chunks
+        // before them are in. Later chunks cannot be merged while one is still writing into result.
+        const size_t chunks = static_cast<size_t>((end - start + chunk_seconds - 1) / chunk_seconds);
+        std::vector<YahooStockData> parts(chunks);
+        std::vector<char> done(chunks, 0);
+        std::vector<std::exception_ptr> errors(chunks);
+        size_t next = 0;
+        size_t merged = 0;
+        bool failed = false;
+        std::mutex mutex;
+        const size_t threads = std::max<size_t>(1, std::min(options.parallel_chunks, chunks));
+        std::vector<std::thread> workers(threads);
+        for (size_t t = 0; t < threads; t++)
+        {
+            workers[t] = std::thread([&]()
             {
-                i++;
-                continue;
-            }
-            std::vector<std::string> tokens(7);
-            std::string token;
-            std::istringstream f(line);
-            int j = 0;
-            while (std::getline(f, token, ','))
+                while (true)
+                {
+                    size_t i;
+                    bool direct;
+                    {
+                        std::lock_guard<std::mutex> lock(mutex);
+                        if (failed || next == chunks)
+                        {
+                            return;
+                        }
+                        i = next++;
+                        direct = merged == i;
+                    }
+                    const std::time_t chunk_start = start + static_cast<std::time_t>(i) * chunk_seconds;
+                    const std::time_t chunk_end = i + 1 == chunks ? end : chunk_start + chunk_seconds;
+                    const std::time_t last = i + 1 == chunks ? std::numeric_limits<std::time_t>::max() : chunk_end - 1;
+                    YahooStockData &target = direct ? result : parts[i];
+                    std::exception_ptr error;
+                    try
+                    {
+                        if (!direct)
+                        {
+                            target.reserve(expected_bars(chunk_start, chunk_end, options.interval));
+                        }
+                        download_range(symbol, chunk_start, chunk_end, chunk_start, last, options, target);
+                    }
+                    catch (...)
+                    {
+                        error = std::current_exception();
+                    }
+                    std::lock_guard<std::mutex> lock(mutex);
+                    done[i] = 1;
+                    errors[i] = error;
+                    failed = failed || error;
+                    if (direct && !error)
+                    {
+                        merged = i + 1;
+                    }
+                    while (!failed && merged < chunks && done[merged])
+                    {
+                        append(result, parts[merged]);
+                        merged++;
+                    }
+                }
+            });
+        }
+        for (size_t t = 0; t < threads; t++)
+        {
+            workers[t].join();
+        }
+        for (size_t i = 0; i < chunks; i++)
+        {
+            if (errors[i])
             {
-                tokens[j] = token;
-                j++;
+                std::rethrow_exception(errors[i]);
             }
-            result.date.push_back(date_util.to_time_t(tokens[0]));
-            result.open.push_back(stod(tokens[1]));
-            result.high.push_back(stod(tokens[2]));
-            result.low.push_back(stod(tokens[3]));
-            result.close.push_back(stod(tokens[4]));
-            result.adj_close.push_back(stod(tokens[5]));
-            result.volume.push_back(stod(tokens[6]));
         }
         return result;
     }
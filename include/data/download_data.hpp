@@ -3,13 +3,29 @@
 #include <vector>
 #include <string>
 #include <ctime>
+#include <stdexcept>
 namespace portfolio_optimizer::data
 {
     static datetime date_util;
+    // Length of one bar. Intraday bars are stamped with their start time to the second.
+    enum class BarInterval
+    {
+        OneMinute,
+        FiveMinutes,
+        OneHour,
+        OneDay
+    };
+    // Yahoo's name of the interval: 1m, 5m, 1h or 1d
+    const char *interval_name(BarInterval interval);
+    std::time_t interval_seconds(BarInterval interval);
+    // Bars of [start, end]: one per calendar day for daily data, one per interval of a 6.5 hour session on every
+    // weekday for intraday data. Downloads reserve their columns from it.
+    size_t expected_bars(const std::time_t &start, const std::time_t &end, BarInterval interval);
     class YahooStockData
     {
     public:
         std::string symbol;
+        BarInterval interval = BarInterval::OneDay;
         std::vector<std::time_t> date;
         std::vector<double> open;
         std::vector<double> high;
@@ -27,11 +43,59 @@ namespace portfolio_optimizer::data
             Volume
         };
         std::vector<double> get_return(ReturnColumn column);
+        const std::vector<double> &column(ReturnColumn column) const
+        {
+            switch (column)
+            {
+            case ReturnColumn::Open:
+                return open;
+            case ReturnColumn::High:
+                return high;
+            case ReturnColumn::Low:
+                return low;
+            case ReturnColumn::Close:
+                return close;
+            case ReturnColumn::AdjClose:
+                return adj_close;
+            case ReturnColumn::Volume:
+                return volume;
+            }
+            throw std::invalid_argument("Unknown return column");
+        }
         std::string to_string();
         void reserve(size_t size);
     };
+    // Thrown when a download fails. http_code is 0 when no response was received and
+    // retry_after holds the server's Retry-After hint in seconds, or 0 when absent.
+    class DownloadError : public std::runtime_error
+    {
+    public:
+        DownloadError(const std::string &message, const long http_code, const int curl_code, const double retry_after)
+            : std::runtime_error(message), http_code(http_code), curl_code(curl_code), retry_after(retry_after)
+        {
+        }
+        long http_code;
+        int curl_code;
+        double retry_after;
+    };
+    struct DownloadOptions
+    {
+        // Scheme and authority the request is sent to, lets tests point at a local server
+        std::string host = "https://query1.finance.yahoo.com";
+        long timeout_ms = 0;
+        bool verbose = false;
+        BarInterval interval = BarInterval::OneDay;
+        // Longest range of one request. Longer ranges are split into chunks that download concurrently and are
+        // stitched in order. 0 stays within Yahoo's per-request limits: 7 days of 1m bars, 30 days of 5m bars,
+        // 180 days of 1h bars and the whole range of daily bars.
+        std::time_t chunk_seconds = 0;
+        // Chunks of one symbol in flight at once
+        size_t parallel_chunks = 4;
+    };
     YahooStockData download_yahoo_data(const std::string &symbol,
                                        const std::time_t &start = date_util.add_time(date_util.now(), -5),
                                        const std::time_t &end = date_util.now(),
                                        const bool verbose = false);
+    YahooStockData download_yahoo_data(const std::string &symbol, const std::time_t &start, const std::time_t &end,
+                                       const DownloadOptions &options);
 }
\ No newline at end of file
@@ -0,0 +1,290 @@
+#include "download_scheduler.hpp"
+#include <thread>
+#include <condition_variable>
+#include <algorithm>
+#include <cmath>
+namespace portfolio_optimizer::data
+{
+    namespace
+    {
+        bool is_retryable(const long http_code)
+        {
+            // 0 means the transfer itself failed (timeout, reset connection...)
+            return http_code == 0 || http_code == 408 || http_code == 429 || http_code >= 500;
+        }
+    }
+    DownloadScheduler::DownloadScheduler(const SchedulerOptions &options)
+        : DownloadScheduler(options, [](const DownloadJob &job, const DownloadOptions &download)
+                            { return download_yahoo_data(job.symbol, job.start, job.end, download); })
+    {
+    }
+    DownloadScheduler::DownloadScheduler(const SchedulerOptions &options, const Fetch &fetch)
+    {
+        if (options.min_concurrency == 0 || options.min_concurrency > options.max_concurrency)
+        {
+            throw std::invalid_argument("Concurrency bounds must satisfy 0 < min_concurrency <= max_concurrency.");
+        }
+        this->options = options;
+        this->fetch = fetch;
+        this->random.seed(options.seed);
+    }
+    DownloadScheduler::HostState &DownloadScheduler::host_state(const std::string &host)
+    {
+        auto found = hosts.find(host);
+        if (found != hosts.end())
+        {
+            return found->second;
+        }
+        HostState &state = hosts[host];
+        state.limit = static_cast<double>(std::clamp(options.initial_concurrency, options.min_concurrency, options.max_concurrency));
+        state.metrics.host = host;
+        return state;
+    }
+    void DownloadScheduler::decrease(HostState &state, Clock::time_point now, double latency)
+    {
+        // A burst of rejections from one overload episode only counts once. The round trip is the mean latency of
+        // successes, or this response's own latency before the first success.
+        const double round_trip = state.metrics.successes > 0 ? state.metrics.mean_latency : latency;
+        if (now - state.last_decrease < std::chrono::duration<double>(round_trip))
+        {
+            return;
+        }
+        state.limit = std::max(static_cast<double>(options.min_concurrency), state.limit * options.multiplicative_decrease);
+        state.window_successes = 0;
+        state.last_decrease = now;
+    }
+    double DownloadScheduler::backoff(size_t attempt, double retry_after)
+    {
+        double ceiling = std::min(options.max_backoff, options.base_backoff * std::pow(2.0, static_cast<double>(attempt - 1)));
+        std::uniform_real_distribution<double> jitter(0, ceiling);
+        return std::max(jitter(random), retry_after);
+    }
+    std::vector<DownloadResult> DownloadScheduler::run(const std::vector<DownloadJob> &jobs)
+    {
+        return run(jobs, Completion());
+    }
+    std::vector<DownloadResult> DownloadScheduler::run(const std::vector<DownloadJob> &jobs, const Completion &on_complete)
+    {
+        // Heap orders: the stalest symbol and the earliest retry end up on top
+        auto staler_last = [](const Pending &a, const Pending &b)
+        {
+            return a.last_updated > b.last_updated || (a.last_updated == b.last_updated && a.index > b.index);
+        };
+        auto earlier_last = [](const Pending &a, const Pending &b)
+        {
+            return a.not_before > b.not_before;
+        };
+        std::vector<DownloadResult> results(jobs.size());
+        std::vector<Pending> delayed;
+        std::condition_variable changed;
+        size_t remaining = jobs.size();
+        auto host_of = [&](size_t index) -> const std::string &
+        {
+            return jobs[index].host.empty() ? options.download.host : jobs[index].host;
+        };
+        size_t used_hosts = 0;
+        std::unordered_map<std::string, size_t> previous_requests;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            for (auto &[host, state] : hosts)
+            {
+                previous_requests[host] = state.metrics.requests;
+            }
+            for (size_t i = 0; i < jobs.size(); i++)
+            {
+                results[i].symbol = jobs[i].symbol;
+                HostState &state = host_state(host_of(i));
+                used_hosts += state.ready.empty();
+                state.ready.push_back({i, jobs[i].last_updated, Clock::time_point()});
+                std::push_heap(state.ready.begin(), state.ready.end(), staler_last);
+            }
+        }
+        auto worker = [&]()
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            while (remaining > 0)
+            {
+                Clock::time_point now = Clock::now();
+                while (!delayed.empty() && delayed.front().not_before <= now)
+                {
+                    std::pop_heap(delayed.begin(), delayed.end(), earlier_last);
+                    Pending retry = delayed.back();
+                    delayed.pop_back();
+                    HostState &state = host_state(host_of(retry.index));
+                    state.ready.push_back(retry);
+                    std::push_heap(state.ready.begin(), state.ready.end(), staler_last);
+                }
+                HostState *chosen = nullptr;
+                for (auto &[host, state] : hosts)
+                {
+                    if (!state.ready.empty() && state.in_flight < std::max<size_t>(1, static_cast<size_t>(state.limit)))
+                    {
+                        chosen = &state;
+                        break;
+                    }
+                }
+                if (chosen == nullptr)
+                {
+                    if (delayed.empty())
+                    {
+                        changed.wait(lock);
+                    }
+                    else
+                    {
+                        changed.wait_until(lock, delayed.front().not_before);
+                    }
+                    continue;
+                }
+                HostState &state = *chosen;
+                std::pop_heap(state.ready.begin(), state.ready.end(), staler_last);
+                Pending job = state.ready.back();
+                state.ready.pop_back();
+                state.in_flight++;
+                state.metrics.requests++;
+                state.metrics.peak_in_flight = std::max(state.metrics.peak_in_flight, state.in_flight);
+                DownloadResult &result = results[job.index];
+                result.attempts++;
+                DownloadOptions request = options.download;
+                request.host = host_of(job.index);
+                lock.unlock();
+
+                YahooStockData data;
+                bool success = false;
+                bool permanent = false;
+                long http_code = 0;
+                int curl_code = 0;
+                double retry_after = 0;
+                std::string error;
+                Clock::time_point sent = Clock::now();
+                try
+                {
+                    data = fetch(jobs[job.index], request);
+                    success = true;
+                    http_code = 200;
+                }
+                catch (const DownloadError &e)
+                {
+                    http_code = e.http_code;
+                    curl_code = e.curl_code;
+                    retry_after = e.retry_after;
+                    error = e.what();
+                }
+                catch (const std::exception &e)
+                {
+                    // Anything other than a DownloadError (bad symbol, parse failure...) is permanent
+                    permanent = true;
+                    error = e.what();
+                }
+                Clock::time_point received = Clock::now();
+                double latency = std::chrono::duration<double>(received - sent).count();
+
+                lock.lock();
+                bool finished = success;
+                state.in_flight--;
+                HostMetrics &metrics = state.metrics;
+                result.http_code = http_code;
+                result.curl_code = curl_code;
+                result.retry_after = retry_after;
+                if (success)
+                {
+                    // Only successes are timed, a fast rejection would make every normal response look congested
+                    metrics.successes++;
+                    metrics.mean_latency += (latency - metrics.mean_latency) / static_cast<double>(metrics.successes);
+                    metrics.min_latency = metrics.min_latency == 0 ? latency : std::min(metrics.min_latency, latency);
+                    metrics.rows += data.date.size();
+                    result.data = std::move(data);
+                    result.success = true;
+                    result.error.clear();
+                    remaining--;
+                    if (latency > options.latency_threshold * metrics.min_latency)
+                    {
+                        decrease(state, received, latency);
+                    }
+                    else if (++state.window_successes >= state.limit)
+                    {
+                        state.window_successes = 0;
+                        state.limit = std::min(static_cast<double>(options.max_concurrency), state.limit + options.additive_increase);
+                    }
+                }
+                else
+                {
+                    bool retryable = !permanent && is_retryable(http_code);
+                    if (http_code == 429)
+                    {
+                        metrics.throttled++;
+                    }
+                    else if (http_code >= 500)
+                    {
+                        metrics.server_errors++;
+                    }
+                    else
+                    {
+                        metrics.failures++;
+                    }
+                    if (retryable)
+                    {
+                        decrease(state, received, latency);
+                    }
+                    result.error = error;
+                    if (retryable && result.attempts < options.max_attempts)
+                    {
+                        auto delay = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(backoff(result.attempts, retry_after)));
+                        delayed.push_back({job.index, job.last_updated, received + delay});
+                        std::push_heap(delayed.begin(), delayed.end(), earlier_last);
+                    }
+                    else
+                    {
+                        remaining--;
+                        finished = true;
+                    }
+                }
+                changed.notify_all();
+                if (finished && on_complete)
+                {
+                    lock.unlock();
+                    on_complete(job.index, result);
+                    lock.lock();
+                }
+            }
+        };
+        Clock::time_point started = Clock::now();
+        size_t threads = std::min(options.max_concurrency * std::max<size_t>(1, used_hosts), jobs.size());
+        std::vector<std::thread> workers(threads);
+        for (size_t t = 0; t < threads; t++)
+        {
+            workers[t] = std::thread(worker);
+        }
+        for (size_t t = 0; t < threads; t++)
+        {
+            workers[t].join();
+        }
+        double elapsed = std::chrono::duration<double>(Clock::now() - started).count();
+        std::lock_guard<std::mutex> lock(mutex);
+        for (auto &[host, state] : hosts)
+        {
+            auto previous = previous_requests.find(host);
+            if (state.metrics.requests > (previous == previous_requests.end() ? 0 : previous->second))
+            {
+                state.metrics.busy_seconds += elapsed;
+            }
+        }
+        return results;
+    }
+    std::vector<HostMetrics> DownloadScheduler::metrics()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::vector<HostMetrics> result;
+        for (auto &[host, state] : hosts)
+        {
+            HostMetrics metrics = state.metrics;
+            metrics.concurrency_limit = state.limit;
+            if (metrics.busy_seconds > 0)
+            {
+                metrics.requests_per_second = metrics.requests / metrics.busy_seconds;
+                metrics.rows_per_second = metrics.rows / metrics.busy_seconds;
+            }
+            result.push_back(metrics);
+        }
+        return result;
+    }
+}
@@ -0,0 +1,113 @@
+#pragma once
+#include "download_data.hpp"
+#include <vector>
+#include <string>
+#include <ctime>
+#include <mutex>
+#include <random>
+#include <chrono>
+#include <functional>
+#include <unordered_map>
+namespace portfolio_optimizer::data
+{
+    struct DownloadJob
+    {
+        std::string symbol;
+        std::time_t start;
+        std::time_t end;
+        // When the symbol was last refreshed, staler symbols are downloaded first
+        std::time_t last_updated = 0;
+        // Empty uses the scheduler's DownloadOptions::host
+        std::string host;
+    };
+    struct DownloadResult
+    {
+        std::string symbol;
+        YahooStockData data;
+        bool success = false;
+        size_t attempts = 0;
+        // Of the last attempt, as its DownloadError reported them
+        long http_code = 0;
+        int curl_code = 0;
+        double retry_after = 0;
+        std::string error;
+    };
+    struct HostMetrics
+    {
+        std::string host;
+        size_t requests = 0;
+        size_t successes = 0;
+        size_t throttled = 0;
+        size_t server_errors = 0;
+        size_t failures = 0;
+        size_t rows = 0;
+        size_t peak_in_flight = 0;
+        double concurrency_limit = 0;
+        // Of successful requests
+        double mean_latency = 0;
+        double min_latency = 0;
+        double busy_seconds = 0;
+        double requests_per_second = 0;
+        double rows_per_second = 0;
+    };
+    struct SchedulerOptions
+    {
+        size_t initial_concurrency = 4;
+        size_t min_concurrency = 1;
+        size_t max_concurrency = 64;
+        // The limit grows by additive_increase per window of limit successful requests
+        double additive_increase = 1;
+        // and is multiplied by multiplicative_decrease on 429/5xx or congestion, at most once per round trip
+        double multiplicative_decrease = 0.5;
+        // A response slower than latency_threshold times the fastest success seen counts as congestion
+        double latency_threshold = 4;
+        size_t max_attempts = 5;
+        double base_backoff = 0.5;
+        double max_backoff = 30;
+        unsigned int seed = std::random_device{}();
+        DownloadOptions download;
+    };
+    // Fans downloads out over a worker pool while adapting the number of in-flight requests per
+    // host with AIMD, retrying throttled or failed requests with jittered exponential backoff.
+    // Failed symbols are reported in their DownloadResult instead of aborting the batch.
+    class DownloadScheduler
+    {
+    public:
+        typedef std::function<YahooStockData(const DownloadJob &job, const DownloadOptions &options)> Fetch;
+        typedef std::function<void(size_t index, DownloadResult &result)> Completion;
+        DownloadScheduler(const SchedulerOptions &options = SchedulerOptions());
+        // fetch replaces download_yahoo_data, it should throw DownloadError on failure
+        DownloadScheduler(const SchedulerOptions &options, const Fetch &fetch);
+        std::vector<DownloadResult> run(const std::vector<DownloadJob> &jobs);
+        // on_complete runs on the worker that finished jobs[index], outside the scheduler lock and possibly
+        // concurrently with other jobs, as soon as it succeeded or ran out of attempts. It may move the data out.
+        std::vector<DownloadResult> run(const std::vector<DownloadJob> &jobs, const Completion &on_complete);
+        std::vector<HostMetrics> metrics();
+
+    private:
+        typedef std::chrono::steady_clock Clock;
+        struct Pending
+        {
+            size_t index;
+            std::time_t last_updated;
+            Clock::time_point not_before;
+        };
+        struct HostState
+        {
+            std::vector<Pending> ready;
+            double limit;
+            size_t in_flight = 0;
+            size_t window_successes = 0;
+            Clock::time_point last_decrease;
+            HostMetrics metrics;
+        };
+        SchedulerOptions options;
+        Fetch fetch;
+        std::mutex mutex;
+        std::mt19937 random;
+        std::unordered_map<std::string, HostState> hosts;
+        HostState &host_state(const std::string &host);
+        void decrease(HostState &state, Clock::time_point now, double latency);
+        double backoff(size_t attempt, double retry_after);
+    };
+}
@@ -0,0 +1,326 @@
+#include "returns.hpp"
+#include "../kernels/kernels.hpp"
+#include <cmath>
+#include <atomic>
+#include <thread>
+#include <algorithm>
+#include <iterator>
+#include <stdexcept>
+namespace portfolio_optimizer::data
+{
+    namespace
+    {
+        int64_t period_key(const std::time_t &time, ReturnFrequency frequency)
+        {
+            if (frequency == ReturnFrequency::Monthly)
+            {
+                std::tm tm = local_time(time);
+                return static_cast<int64_t>(tm.tm_year) * 12 + tm.tm_mon;
+            }
+            // Weeks start on Monday, 1970-01-01 was a Thursday
+            int64_t days = local_day(time);
+            return days + 3 >= 0 ? (days + 3) / 7 : (days - 3) / 7;
+        }
+        // sum and sum_squares are taken about shift, a guess at the mean: the variance then comes from deviations of the
+        // order of the volatility instead of two sums of squared returns that nearly cancel for low-volatility series
+        ReturnMoments finish_moments(double sum, double sum_squares, double shift, double log_total, size_t count, double periods_per_year)
+        {
+            ReturnMoments moments = {};
+            if (count == 0)
+            {
+                return moments;
+            }
+            const double offset = sum / count;
+            moments.mean = shift + offset;
+            moments.variance = count > 1 ? (sum_squares - sum * offset) / (count - 1) : 0;
+            moments.log_mean = log_total / count;
+            moments.annualized_mean = moments.mean * periods_per_year;
+            moments.annualized_variance = moments.variance * periods_per_year;
+            moments.annualized_log_mean = moments.log_mean * periods_per_year;
+            return moments;
+        }
+        // The geometric mean return, known from the first and last price before the sweep, is the shift
+        ReturnMoments simple_returns(const double *prices, size_t size, double *output, double periods_per_year)
+        {
+            double sum = 0;
+            double sum_squares = 0;
+            const double log_total = std::log(prices[size - 1] / prices[0]);
+            const double shift = std::expm1(log_total / (size - 1));
+            kernels::active().simple_returns(prices, size, std::isfinite(shift) ? shift : 0, output, &sum, &sum_squares);
+            return finish_moments(sum, sum_squares, std::isfinite(shift) ? shift : 0, log_total, size - 1, periods_per_year);
+        }
+        // Log returns telescope, so their mean is exact before the sweep and the sums are about it
+        ReturnMoments log_returns(const double *prices, size_t size, double *output, double periods_per_year)
+        {
+            const double log_total = std::log(prices[size - 1] / prices[0]);
+            const double shift = std::isfinite(log_total) ? log_total / (size - 1) : 0;
+            double sum = 0;
+            double sum_squares = 0;
+            for (size_t i = 1; i < size; i++)
+            {
+                double r = std::log(prices[i] / prices[i - 1]);
+                output[i - 1] = r;
+                double d = r - shift;
+                sum += d;
+                sum_squares += d * d;
+            }
+            return finish_moments(sum, sum_squares, shift, shift * (size - 1) + sum, size - 1, periods_per_year);
+        }
+        // Workers pull tickers from a shared counter, each one owning a reusable scratch buffer
+        template <typename Body>
+        void parallel_for(size_t count, size_t threads, Body body)
+        {
+            std::atomic<size_t> next = 0;
+            std::vector<std::thread> workers(threads);
+            for (size_t t = 0; t < threads; t++)
+            {
+                workers[t] = std::thread([&]()
+                {
+                    std::vector<double> scratch;
+                    for (size_t i = next++; i < count; i = next++)
+                    {
+                        body(i, scratch);
+                    }
+                });
+            }
+            for (size_t t = 0; t < threads; t++)
+            {
+                workers[t].join();
+            }
+        }
+        // One sweep per column rather than one loop over all of them: columns are separate contiguous vectors and the
+        // output is series-major, so each sweep is one read and one write stream the vector kernel consumes at full
+        // width. Interleaving the columns would move the same bytes through 2 * columns streams with scalar gathers.
+        std::vector<ReturnMoments> compute_ticker_returns(const YahooStockData &data, const std::vector<YahooStockData::ReturnColumn> &columns,
+                                                          const std::vector<size_t> &indices, std::vector<double> &scratch, double *output,
+                                                          ReturnType type, ReturnFrequency frequency)
+        {
+            std::vector<ReturnMoments> moments(columns.size());
+            const size_t periods = frequency == ReturnFrequency::Daily ? data.date.size() : indices.size();
+            const size_t count = periods > 1 ? periods - 1 : 0;
+            for (size_t c = 0; c < columns.size(); c++)
+            {
+                if (count == 0)
+                {
+                    moments[c] = {};
+                    continue;
+                }
+                const double *prices = data.column(columns[c]).data();
+                if (frequency != ReturnFrequency::Daily)
+                {
+                    scratch.resize(indices.size());
+                    for (size_t i = 0; i < indices.size(); i++)
+                    {
+                        scratch[i] = prices[indices[i]];
+                    }
+                    prices = scratch.data();
+                }
+                moments[c] = compute_returns(prices, periods, output + c * count, type, periods_per_year(frequency));
+            }
+            return moments;
+        }
+    }
+    double periods_per_year(ReturnFrequency frequency)
+    {
+        switch (frequency)
+        {
+        case ReturnFrequency::Daily:
+            return 252;
+        case ReturnFrequency::Weekly:
+            return 52;
+        case ReturnFrequency::Monthly:
+            return 12;
+        }
+        throw std::invalid_argument("Unknown return frequency");
+    }
+    void resample_indices(const std::vector<std::time_t> &dates, ReturnFrequency frequency, std::vector<size_t> &indices)
+    {
+        indices.clear();
+        if (frequency == ReturnFrequency::Daily)
+        {
+            indices.resize(dates.size());
+            for (size_t i = 0; i < dates.size(); i++)
+            {
+                indices[i] = i;
+            }
+            return;
+        }
+        if (dates.empty())
+        {
+            return;
+        }
+        int64_t current = period_key(dates[0], frequency);
+        for (size_t i = 1; i < dates.size(); i++)
+        {
+            int64_t next = period_key(dates[i], frequency);
+            if (next != current)
+            {
+                indices.push_back(i - 1);
+                current = next;
+            }
+        }
+        indices.push_back(dates.size() - 1);
+    }
+    ReturnMoments compute_returns(const double *prices, size_t size, double *output, ReturnType type, double periods_per_year)
+    {
+        if (size < 2)
+        {
+            return {};
+        }
+        if (type == ReturnType::Log)
+        {
+            return log_returns(prices, size, output, periods_per_year);
+        }
+        return simple_returns(prices, size, output, periods_per_year);
+    }
+    size_t return_count(const YahooStockData &data, ReturnFrequency frequency)
+    {
+        size_t periods = data.date.size();
+        if (frequency != ReturnFrequency::Daily)
+        {
+            std::vector<size_t> indices;
+            resample_indices(data.date, frequency, indices);
+            periods = indices.size();
+        }
+        return periods > 1 ? periods - 1 : 0;
+    }
+    std::vector<ReturnMoments> compute_returns(const YahooStockData &data, const std::vector<YahooStockData::ReturnColumn> &columns,
+                                               double *output, ReturnType type, ReturnFrequency frequency)
+    {
+        std::vector<size_t> indices;
+        std::vector<double> scratch;
+        if (frequency != ReturnFrequency::Daily)
+        {
+            resample_indices(data.date, frequency, indices);
+        }
+        return compute_ticker_returns(data, columns, indices, scratch, output, type, frequency);
+    }
+    void align(std::vector<YahooStockData> &data)
+    {
+        if (data.size() < 2)
+        {
+            return;
+        }
+        std::vector<std::time_t> common = data[0].date;
+        std::vector<std::time_t> intersection;
+        for (size_t i = 1; i < data.size(); i++)
+        {
+            intersection.clear();
+            std::set_intersection(common.begin(), common.end(), data[i].date.begin(), data[i].date.end(), std::back_inserter(intersection));
+            common.swap(intersection);
+        }
+        for (size_t i = 0; i < data.size(); i++)
+        {
+            YahooStockData &ticker = data[i];
+            if (ticker.date.size() == common.size())
+            {
+                continue;
+            }
+            size_t kept = 0;
+            for (size_t row = 0, j = 0; row < ticker.date.size() && j < common.size(); row++)
+            {
+                if (ticker.date[row] != common[j])
+                {
+                    continue;
+                }
+                ticker.date[kept] = ticker.date[row];
+                ticker.open[kept] = ticker.open[row];
+                ticker.high[kept] = ticker.high[row];
+                ticker.low[kept] = ticker.low[row];
+                ticker.close[kept] = ticker.close[row];
+                ticker.adj_close[kept] = ticker.adj_close[row];
+                ticker.volume[kept] = ticker.volume[row];
+                kept++;
+                j++;
+            }
+            ticker.date.resize(kept);
+            ticker.open.resize(kept);
+            ticker.high.resize(kept);
+            ticker.low.resize(kept);
+            ticker.close.resize(kept);
+            ticker.adj_close.resize(kept);
+            ticker.volume.resize(kept);
+        }
+    }
+    size_t ReturnsPanel::size() const
+    {
+        return symbols.size();
+    }
+    std::span<const double> ReturnsPanel::series(size_t index) const
+    {
+        return std::span<const double>(values.data() + offsets[index], offsets[index + 1] - offsets[index]);
+    }
+    std::span<double> ReturnsPanel::series(size_t index)
+    {
+        return std::span<double>(values.data() + offsets[index], offsets[index + 1] - offsets[index]);
+    }
+    std::span<const std::time_t> ReturnsPanel::dates(size_t index) const
+    {
+        size_t ticker = series_ticker[index];
+        return std::span<const std::time_t>(period_dates.data() + date_offsets[ticker], date_offsets[ticker + 1] - date_offsets[ticker]);
+    }
+    std::unordered_map<std::string, std::vector<double>> ReturnsPanel::to_map(YahooStockData::ReturnColumn column) const
+    {
+        std::unordered_map<std::string, std::vector<double>> result(size());
+        for (size_t i = 0; i < size(); i++)
+        {
+            if (columns[i] == column)
+            {
+                std::span<const double> values = series(i);
+                result[symbols[i]] = std::vector<double>(values.begin(), values.end());
+            }
+        }
+        return result;
+    }
+    ReturnsPanel compute_returns(const std::vector<YahooStockData> &data, const std::vector<YahooStockData::ReturnColumn> &columns,
+                                 ReturnType type, ReturnFrequency frequency, size_t threads)
+    {
+        if (threads == 0)
+        {
+            threads = std::max<size_t>(1, std::thread::hardware_concurrency());
+        }
+        threads = std::max<size_t>(1, std::min(threads, data.size()));
+        std::vector<std::vector<size_t>> indices(data.size());
+        if (frequency != ReturnFrequency::Daily)
+        {
+            parallel_for(data.size(), threads, [&](size_t i, std::vector<double> &)
+            {
+                resample_indices(data[i].date, frequency, indices[i]);
+            });
+        }
+        ReturnsPanel panel;
+        panel.type = type;
+        panel.frequency = frequency;
+        panel.offsets.push_back(0);
+        panel.date_offsets.push_back(0);
+        std::vector<size_t> counts(data.size());
+        for (size_t i = 0; i < data.size(); i++)
+        {
+            size_t periods = frequency == ReturnFrequency::Daily ? data[i].date.size() : indices[i].size();
+            counts[i] = periods > 1 ? periods - 1 : 0;
+            panel.date_offsets.push_back(panel.date_offsets.back() + counts[i]);
+            for (size_t c = 0; c < columns.size(); c++)
+            {
+                panel.symbols.push_back(data[i].symbol);
+                panel.columns.push_back(columns[c]);
+                panel.series_ticker.push_back(i);
+                panel.offsets.push_back(panel.offsets.back() + counts[i]);
+            }
+        }
+        panel.values.resize(panel.offsets.back());
+        panel.period_dates.resize(panel.date_offsets.back());
+        panel.moments.resize(panel.symbols.size());
+        parallel_for(data.size(), threads, [&](size_t i, std::vector<double> &scratch)
+        {
+            std::vector<ReturnMoments> moments = compute_ticker_returns(data[i], columns, indices[i], scratch,
+                                                                        panel.values.data() + panel.offsets[i * columns.size()], type, frequency);
+            std::copy(moments.begin(), moments.end(), panel.moments.begin() + i * columns.size());
+            std::time_t *dates = panel.period_dates.data() + panel.date_offsets[i];
+            for (size_t j = 0; j < counts[i]; j++)
+            {
+                dates[j] = data[i].date[frequency == ReturnFrequency::Daily ? j + 1 : indices[i][j + 1]];
+            }
+        });
+        return panel;
+    }
+}
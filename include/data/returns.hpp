@@ -0,0 +1,74 @@
+#pragma once
+#include "download_data.hpp"
+#include "date_utils.hpp"
+#include <vector>
+#include <string>
+#include <span>
+#include <unordered_map>
+#include <ctime>
+namespace portfolio_optimizer::data
+{
+    enum class ReturnType
+    {
+        Simple,
+        Log
+    };
+    enum class ReturnFrequency
+    {
+        Daily,
+        Weekly,
+        Monthly
+    };
+    typedef struct
+    {
+        double mean;
+        double variance;
+        // Mean of log(1 + r), obtained from the first and last price without an extra pass
+        double log_mean;
+        double annualized_mean;
+        double annualized_variance;
+        double annualized_log_mean;
+    } ReturnMoments;
+    double periods_per_year(ReturnFrequency frequency);
+    // Indices of the last observation of every week/month. Daily frequency keeps every row.
+    void resample_indices(const std::vector<std::time_t> &dates, ReturnFrequency frequency, std::vector<size_t> &indices);
+    // Writes size - 1 returns of prices into output and returns their moments from the same sweep.
+    ReturnMoments compute_returns(const double *prices, size_t size, double *output, ReturnType type, double periods_per_year);
+    // Returns of every requested column of data, written column after column into output
+    // (columns.size() blocks of periods - 1 values, see return_count).
+    std::vector<ReturnMoments> compute_returns(const YahooStockData &data, const std::vector<YahooStockData::ReturnColumn> &columns,
+                                               double *output, ReturnType type = ReturnType::Simple,
+                                               ReturnFrequency frequency = ReturnFrequency::Daily);
+    size_t return_count(const YahooStockData &data, ReturnFrequency frequency = ReturnFrequency::Daily);
+    // Drops every row whose date is missing from any of the tickers, so their returns line up
+    void align(std::vector<YahooStockData> &data);
+    class ReturnsPanel
+    {
+    public:
+        ReturnType type = ReturnType::Simple;
+        ReturnFrequency frequency = ReturnFrequency::Daily;
+        // One entry per series, series are ordered ticker by ticker and column by column
+        std::vector<std::string> symbols;
+        std::vector<YahooStockData::ReturnColumn> columns;
+        std::vector<ReturnMoments> moments;
+        size_t size() const;
+        std::span<const double> series(size_t index) const;
+        std::span<double> series(size_t index);
+        // Date of the end of the period of every return of the series
+        std::span<const std::time_t> dates(size_t index) const;
+        std::unordered_map<std::string, std::vector<double>> to_map(YahooStockData::ReturnColumn column) const;
+
+    private:
+        std::vector<double> values;
+        std::vector<size_t> offsets;
+        std::vector<std::time_t> period_dates;
+        std::vector<size_t> date_offsets;
+        std::vector<size_t> series_ticker;
+        friend ReturnsPanel compute_returns(const std::vector<YahooStockData> &data, const std::vector<YahooStockData::ReturnColumn> &columns,
+                                            ReturnType type, ReturnFrequency frequency, size_t threads);
+    };
+    // Computes the panel of every ticker in parallel, threads = 0 uses every hardware thread
+    ReturnsPanel compute_returns(const std::vector<YahooStockData> &data, const std::vector<YahooStockData::ReturnColumn> &columns,
+                                 ReturnType type = ReturnType::Simple, ReturnFrequency frequency = ReturnFrequency::Daily,
+                                 size_t threads = 0);
+}
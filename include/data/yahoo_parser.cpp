@@ -0,0 +1,180 @@
+#include "yahoo_parser.hpp"
+#include "date_utils.hpp"
+#include <charconv>
+#include <cstring>
+#include <limits>
+namespace portfolio_optimizer::data
+{
+    namespace
+    {
+        bool parse_int(const char *begin, const char *end, int &value)
+        {
+            auto [ptr, ec] = std::from_chars(begin, end, value);
+            return ec == std::errc() && ptr == end;
+        }
+        double parse_double(const char *begin, const char *end)
+        {
+            double value = 0;
+            auto [ptr, ec] = std::from_chars(begin, end, value);
+            if (ec != std::errc() || ptr != end)
+            {
+                // Yahoo writes "null" for missing quotes
+                return std::numeric_limits<double>::quiet_NaN();
+            }
+            return value;
+        }
+    }
+    YahooCsvParser::YahooCsvParser(YahooStockData &output, const std::time_t &start, const std::time_t &end)
+        : output(output), range_start(start), range_end(end)
+    {
+    }
+    void YahooCsvParser::feed(const char *chunk, size_t size)
+    {
+        const char *p = chunk;
+        const char *last = chunk + size;
+        if (!pending.empty())
+        {
+            const char *newline = static_cast<const char *>(std::memchr(p, '\n', size));
+            if (newline == nullptr)
+            {
+                pending.append(p, size);
+                return;
+            }
+            pending.append(p, newline);
+            parse_line(pending.data(), pending.data() + pending.size());
+            pending.clear();
+            p = newline + 1;
+        }
+        while (p < last)
+        {
+            const char *newline = static_cast<const char *>(std::memchr(p, '\n', last - p));
+            if (newline == nullptr)
+            {
+                pending.assign(p, last);
+                return;
+            }
+            parse_line(p, newline);
+            p = newline + 1;
+        }
+    }
+    void YahooCsvParser::finish()
+    {
+        if (!pending.empty())
+        {
+            parse_line(pending.data(), pending.data() + pending.size());
+            pending.clear();
+        }
+    }
+    size_t YahooCsvParser::rows() const
+    {
+        return row_count;
+    }
+    size_t YahooCsvParser::skipped_rows() const
+    {
+        return skipped_count;
+    }
+    bool YahooCsvParser::parse_date(const char *begin, const char *end, std::time_t &date)
+    {
+        // YYYY-MM-DD, interpreted like std::get_time + std::mktime with tm_isdst = 0. Intraday rows carry
+        // " HH:MM:SS" or "THH:MM:SS" after the date and optionally a zone (Z, +HH:MM, +HHMM), zoned times are UTC.
+        int year, month, day;
+        if (end - begin < 10 || begin[4] != '-' || begin[7] != '-' ||
+            !parse_int(begin, begin + 4, year) || !parse_int(begin + 5, begin + 7, month) ||
+            !parse_int(begin + 8, begin + 10, day) || month < 1 || month > 12 || day < 1 || day > 31)
+        {
+            return false;
+        }
+        std::time_t seconds = 0;
+        bool zoned = false;
+        const char *time = begin + 10;
+        if (time != end)
+        {
+            int hour, minute, second;
+            if (end - time < 9 || (time[0] != ' ' && time[0] != 'T') || time[3] != ':' || time[6] != ':' ||
+                !parse_int(time + 1, time + 3, hour) || !parse_int(time + 4, time + 6, minute) ||
+                !parse_int(time + 7, time + 9, second) || hour > 23 || minute > 59 || second > 60)
+            {
+                return false;
+            }
+            seconds = static_cast<std::time_t>(hour) * 3600 + minute * 60 + second;
+            const char *zone = time + 9;
+            if (zone != end)
+            {
+                zoned = true;
+                int zone_hour, zone_minute;
+                if (end - zone != 1 || *zone != 'Z')
+                {
+                    const bool colon = end - zone == 6 && zone[3] == ':';
+                    if ((end - zone != 5 && !colon) || (*zone != '+' && *zone != '-') ||
+                        !parse_int(zone + 1, zone + 3, zone_hour) || !parse_int(zone + 3 + colon, end, zone_minute))
+                    {
+                        return false;
+                    }
+                    std::time_t offset = static_cast<std::time_t>(zone_hour) * 3600 + zone_minute * 60;
+                    seconds -= *zone == '+' ? offset : -offset;
+                }
+            }
+        }
+        if (zoned)
+        {
+            date = static_cast<std::time_t>(days_from_civil(year, month, day)) * 86400 + seconds;
+            return true;
+        }
+        if (year != cached_year || month != cached_month)
+        {
+            std::tm tm = {};
+            tm.tm_year = year - 1900;
+            tm.tm_mon = month - 1;
+            tm.tm_mday = 1;
+            cached_month_start = std::mktime(&tm);
+            cached_year = year;
+            cached_month = month;
+        }
+        date = cached_month_start + static_cast<std::time_t>(day - 1) * 86400 + seconds;
+        return true;
+    }
+    void YahooCsvParser::parse_line(const char *begin, const char *end)
+    {
+        if (end > begin && end[-1] == '\r')
+        {
+            end--;
+        }
+        if (begin == end)
+        {
+            return;
+        }
+        if (!header_skipped)
+        {
+            header_skipped = true;
+            return;
+        }
+        const char *fields[8];
+        int field_count = 0;
+        fields[field_count++] = begin;
+        for (const char *p = begin; p < end && field_count < 8; p++)
+        {
+            if (*p == ',')
+            {
+                fields[field_count++] = p + 1;
+            }
+        }
+        std::time_t date;
+        if (field_count != 7 || !parse_date(fields[0], fields[1] - 1, date))
+        {
+            skipped_count++;
+            return;
+        }
+        if (date < range_start || date > range_end)
+        {
+            return;
+        }
+        output.date.push_back(date);
+        output.open.push_back(parse_double(fields[1], fields[2] - 1));
+        output.high.push_back(parse_double(fields[2], fields[3] - 1));
+        output.low.push_back(parse_double(fields[3], fields[4] - 1));
+        output.close.push_back(parse_double(fields[4], fields[5] - 1));
+        output.adj_close.push_back(parse_double(fields[5], fields[6] - 1));
+        output.volume.push_back(parse_double(fields[6], end));
+        row_count++;
+    }
+}
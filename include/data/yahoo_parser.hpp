@@ -0,0 +1,37 @@
+#pragma once
+#include "download_data.hpp"
+#include <string>
+#include <ctime>
+#include <limits>
+namespace portfolio_optimizer::data
+{
+    // Push-style parser for Yahoo history CSVs. Chunks can be fed as they arrive from the
+    // network or from disk, partial lines are carried over to the next chunk and rows are
+    // appended directly into the columns of the output YahooStockData. Rows dated outside
+    // [start, end] are dropped.
+    class YahooCsvParser
+    {
+    public:
+        YahooCsvParser(YahooStockData &output,
+                       const std::time_t &start = std::numeric_limits<std::time_t>::min(),
+                       const std::time_t &end = std::numeric_limits<std::time_t>::max());
+        void feed(const char *chunk, size_t size);
+        void finish();
+        size_t rows() const;
+        size_t skipped_rows() const;
+
+    private:
+        YahooStockData &output;
+        std::time_t range_start;
+        std::time_t range_end;
+        std::string pending;
+        bool header_skipped = false;
+        size_t row_count = 0;
+        size_t skipped_count = 0;
+        int cached_year = -1;
+        int cached_month = -1;
+        std::time_t cached_month_start = 0;
+        void parse_line(const char *begin, const char *end);
+        bool parse_date(const char *begin, const char *end, std::time_t &date);
+    };
+}
@@ -0,0 +1,339 @@
+//Included once by every kernels_<level>.cpp, each compiled with its level's instruction set. The includer defines
+//KERNEL_TABLE, the name of the table to define, and KERNEL_WIDTH, the doubles per vector register.
+//Nothing here has external linkage or calls inline functions of other headers, so the linker can never hand the
+//copy built for a wider instruction set to code that runs on a narrower one.
+#include "kernels.hpp"
+#include <cstring>
+namespace portfolio_optimizer::kernels
+{
+    namespace
+    {
+        constexpr size_t width = KERNEL_WIDTH;
+#if defined(__GNUC__)
+        //Vector extension, so the variants do not depend on the auto-vectorizer's cost model
+        typedef double Vector __attribute__((vector_size(width * sizeof(double))));
+#else
+        struct Vector
+        {
+            double lane[width];
+            double &operator[](size_t u)
+            {
+                return lane[u];
+            }
+            double operator[](size_t u) const
+            {
+                return lane[u];
+            }
+        };
+        Vector operator+(Vector x, const Vector &y)
+        {
+            for (size_t u = 0; u < width; u++)
+            {
+                x[u] += y[u];
+            }
+            return x;
+        }
+        Vector operator-(Vector x, const Vector &y)
+        {
+            for (size_t u = 0; u < width; u++)
+            {
+                x[u] -= y[u];
+            }
+            return x;
+        }
+        Vector operator*(Vector x, const Vector &y)
+        {
+            for (size_t u = 0; u < width; u++)
+            {
+                x[u] *= y[u];
+            }
+            return x;
+        }
+        Vector operator/(Vector x, const Vector &y)
+        {
+            for (size_t u = 0; u < width; u++)
+            {
+                x[u] /= y[u];
+            }
+            return x;
+        }
+#endif
+        //Sized so a depth_block x column_block panel of B stays in L2 while micro_rows x micro_cols blocks of C live in registers
+        constexpr size_t depth_block = 256;
+        constexpr size_t column_block = 512;
+        constexpr size_t micro_rows = 4;
+        constexpr size_t micro_cols = 2 * width;
+        Vector zero()
+        {
+            Vector v;
+            for (size_t u = 0; u < width; u++)
+            {
+                v[u] = 0;
+            }
+            return v;
+        }
+        Vector broadcast(double x)
+        {
+            Vector v;
+            for (size_t u = 0; u < width; u++)
+            {
+                v[u] = x;
+            }
+            return v;
+        }
+        //Unaligned, rows of packed and row-major matrices start anywhere
+        Vector load(const double *x)
+        {
+            Vector v;
+            std::memcpy(&v, x, sizeof(Vector));
+            return v;
+        }
+        void store(double *x, const Vector &v)
+        {
+            std::memcpy(x, &v, sizeof(Vector));
+        }
+        double sum(const Vector &v)
+        {
+            double result = 0;
+            for (size_t u = 0; u < width; u++)
+            {
+                result += v[u];
+            }
+            return result;
+        }
+        size_t smaller(size_t x, size_t y)
+        {
+            return x < y ? x : y;
+        }
+        double dot(const double *x, const double *y, size_t n)
+        {
+            //Two vectors of partial sums hide the latency of the adds
+            Vector first = zero();
+            Vector second = zero();
+            size_t i = 0;
+            for (; i + 2 * width <= n; i += 2 * width)
+            {
+                first = first + load(x + i) * load(y + i);
+                second = second + load(x + i + width) * load(y + i + width);
+            }
+            double result = sum(first + second);
+            for (; i < n; i++)
+            {
+                result += x[i] * y[i];
+            }
+            return result;
+        }
+        void axpy(double alpha, const double *x, double *y, size_t n)
+        {
+            const Vector a = broadcast(alpha);
+            size_t i = 0;
+            for (; i + width <= n; i += width)
+            {
+                store(y + i, load(y + i) + a * load(x + i));
+            }
+            for (; i < n; i++)
+            {
+                y[i] += alpha * x[i];
+            }
+        }
+        void gemm_rows(const double *a, const double *b, double *c, size_t first, size_t last, size_t k, size_t n)
+        {
+            for (size_t i = first * n; i < last * n; i++)
+            {
+                c[i] = 0;
+            }
+            for (size_t kk = 0; kk < k; kk += depth_block)
+            {
+                size_t k_end = smaller(k, kk + depth_block);
+                for (size_t jj = 0; jj < n; jj += column_block)
+                {
+                    size_t j_end = smaller(n, jj + column_block);
+                    size_t i = first;
+                    for (; i + micro_rows <= last; i += micro_rows)
+                    {
+                        size_t j = jj;
+                        for (; j + micro_cols <= j_end; j += micro_cols)
+                        {
+                            Vector block[micro_rows][2];
+                            for (size_t r = 0; r < micro_rows; r++)
+                            {
+                                block[r][0] = zero();
+                                block[r][1] = zero();
+                            }
+                            for (size_t p = kk; p < k_end; p++)
+                            {
+                                const Vector left = load(b + p * n + j);
+                                const Vector right = load(b + p * n + j + width);
+                                for (size_t r = 0; r < micro_rows; r++)
+                                {
+                                    const Vector value = broadcast(a[(i + r) * k + p]);
+                                    block[r][0] = block[r][0] + value * left;
+                                    block[r][1] = block[r][1] + value * right;
+                                }
+                            }
+                            for (size_t r = 0; r < micro_rows; r++)
+                            {
+                                double *c_row = c + (i + r) * n + j;
+                                store(c_row, load(c_row) + block[r][0]);
+                                store(c_row + width, load(c_row + width) + block[r][1]);
+                            }
+                        }
+                        for (; j < j_end; j++)
+                        {
+                            for (size_t r = 0; r < micro_rows; r++)
+                            {
+                                double result = 0;
+                                for (size_t p = kk; p < k_end; p++)
+                                {
+                                    result += a[(i + r) * k + p] * b[p * n + j];
+                                }
+                                c[(i + r) * n + j] += result;
+                            }
+                        }
+                    }
+                    for (; i < last; i++)
+                    {
+                        for (size_t p = kk; p < k_end; p++)
+                        {
+                            axpy(a[i * k + p], b + p * n + jj, c + i * n + jj, j_end - jj);
+                        }
+                    }
+                }
+            }
+        }
+        void rank_k_update(const double *a, const double *b, double *c, size_t m, size_t k, size_t n)
+        {
+            size_t i = 0;
+            for (; i + 2 <= m; i += 2)
+            {
+                const double *a0 = a + i * k;
+                const double *a1 = a0 + k;
+                size_t j = 0;
+                for (; j + 2 <= n; j += 2)
+                {
+                    const double *b0 = b + j * k;
+                    const double *b1 = b0 + k;
+                    //One vector of partial sums per product of the 2 x 2 block, every load feeds two of them
+                    Vector s00 = zero();
+                    Vector s01 = zero();
+                    Vector s10 = zero();
+                    Vector s11 = zero();
+                    size_t p = 0;
+                    for (; p + width <= k; p += width)
+                    {
+                        const Vector x0 = load(a0 + p);
+                        const Vector x1 = load(a1 + p);
+                        const Vector y0 = load(b0 + p);
+                        const Vector y1 = load(b1 + p);
+                        s00 = s00 + x0 * y0;
+                        s01 = s01 + x0 * y1;
+                        s10 = s10 + x1 * y0;
+                        s11 = s11 + x1 * y1;
+                    }
+                    double r00 = sum(s00);
+                    double r01 = sum(s01);
+                    double r10 = sum(s10);
+                    double r11 = sum(s11);
+                    for (; p < k; p++)
+                    {
+                        r00 += a0[p] * b0[p];
+                        r01 += a0[p] * b1[p];
+                        r10 += a1[p] * b0[p];
+                        r11 += a1[p] * b1[p];
+                    }
+                    c[i * n + j] -= r00;
+                    c[i * n + j + 1] -= r01;
+                    c[(i + 1) * n + j] -= r10;
+                    c[(i + 1) * n + j + 1] -= r11;
+                }
+                for (; j < n; j++)
+                {
+                    c[i * n + j] -= dot(a0, b + j * k, k);
+                    c[(i + 1) * n + j] -= dot(a1, b + j * k, k);
+                }
+            }
+            for (; i < m; i++)
+            {
+                for (size_t j = 0; j < n; j++)
+                {
+                    c[i * n + j] -= dot(a + i * k, b + j * k, k);
+                }
+            }
+        }
+        void spmm_rows(const double *x, const double *packed, double *y, size_t first, size_t last, size_t n)
+        {
+            for (size_t i = first * n; i < last * n; i++)
+            {
+                y[i] = 0;
+            }
+            for (size_t i = 0; i < n; i++)
+            {
+                const double *row = packed + i * (i + 1) / 2;
+                //Row i stays in cache while every row of X uses it, as a row for y[i] and as column i for y[0, i)
+                for (size_t r = first; r < last; r++)
+                {
+                    const double *x_row = x + r * n;
+                    double *y_row = y + r * n;
+                    y_row[i] += dot(row, x_row, i) + row[i] * x_row[i];
+                    axpy(x_row[i], row, y_row, i);
+                }
+            }
+        }
+        void packed_rank_one_update(double alpha, const double *x, double *packed, size_t n)
+        {
+            for (size_t i = 0; i < n; i++)
+            {
+                axpy(alpha * x[i], x, packed + i * (i + 1) / 2, i + 1);
+            }
+        }
+        void packed_rank_two_update(const double *x, const double *y, double *packed, size_t n)
+        {
+            for (size_t i = 0; i < n; i++)
+            {
+                double *row = packed + i * (i + 1) / 2;
+                const Vector x_value = broadcast(x[i]);
+                const Vector y_value = broadcast(y[i]);
+                size_t j = 0;
+                for (; j + width <= i + 1; j += width)
+                {
+                    store(row + j, load(row + j) + x_value * load(x + j) - y_value * load(y + j));
+                }
+                for (; j <= i; j++)
+                {
+                    row[j] += x[i] * x[j] - y[i] * y[j];
+                }
+            }
+        }
+        void simple_returns(const double *prices, size_t size, double shift, double *output, double *sum_returns, double *sum_squares)
+        {
+            Vector sums = zero();
+            Vector squares = zero();
+            const Vector shifts = broadcast(shift);
+            const size_t count = size > 0 ? size - 1 : 0;
+            size_t i = 0;
+            for (; i + width <= count; i += width)
+            {
+                const Vector previous = load(prices + i);
+                const Vector r = (load(prices + i + 1) - previous) / previous;
+                store(output + i, r);
+                const Vector d = r - shifts;
+                sums = sums + d;
+                squares = squares + d * d;
+            }
+            double total = sum(sums);
+            double total_squares = sum(squares);
+            for (; i < count; i++)
+            {
+                double r = (prices[i + 1] - prices[i]) / prices[i];
+                output[i] = r;
+                double d = r - shift;
+                total += d;
+                total_squares += d * d;
+            }
+            *sum_returns = total;
+            *sum_squares = total_squares;
+        }
+    }
+    extern const Kernels KERNEL_TABLE;
+    const Kernels KERNEL_TABLE = {dot, axpy, gemm_rows, rank_k_update, spmm_rows, packed_rank_one_update, packed_rank_two_update, simple_returns};
+}
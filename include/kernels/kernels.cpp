@@ -0,0 +1,108 @@
+#include "kernels.hpp"
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <stdexcept>
+namespace portfolio_optimizer::kernels
+{
+    extern const Kernels scalar_kernels;
+#ifdef PORTFOLIO_OPTIMIZER_AVX_KERNELS
+    extern const Kernels avx2_kernels;
+    extern const Kernels avx512_kernels;
+#endif
+    namespace
+    {
+        const Kernels &table([[maybe_unused]] KernelLevel level)
+        {
+#ifdef PORTFOLIO_OPTIMIZER_AVX_KERNELS
+            switch (level)
+            {
+            case KernelLevel::avx512:
+                return avx512_kernels;
+            case KernelLevel::avx2:
+                return avx2_kernels;
+            default:
+                break;
+            }
+#endif
+            return scalar_kernels;
+        }
+        KernelLevel detect()
+        {
+            const KernelLevel levels[] = {KernelLevel::avx512, KernelLevel::avx2, KernelLevel::scalar};
+            const char *forced = std::getenv("PORTFOLIO_OPTIMIZER_KERNELS");
+            if (forced != nullptr)
+            {
+                for (KernelLevel level : levels)
+                {
+                    if (std::strcmp(forced, name(level)) == 0 && supported(level))
+                    {
+                        return level;
+                    }
+                }
+            }
+            for (KernelLevel level : levels)
+            {
+                if (supported(level))
+                {
+                    return level;
+                }
+            }
+            return KernelLevel::scalar;
+        }
+        std::atomic<KernelLevel> &current()
+        {
+            static std::atomic<KernelLevel> level(detect());
+            return level;
+        }
+    }
+    bool supported(KernelLevel level)
+    {
+        if (level == KernelLevel::scalar)
+        {
+            return true;
+        }
+#ifdef PORTFOLIO_OPTIMIZER_AVX_KERNELS
+        __builtin_cpu_init();
+        if (level == KernelLevel::avx2)
+        {
+            return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+        }
+        if (level == KernelLevel::avx512)
+        {
+            //Also checks that the operating system saves the AVX-512 registers
+            return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+        }
+#endif
+        return false;
+    }
+    KernelLevel level()
+    {
+        return current().load(std::memory_order_relaxed);
+    }
+    void set_level(KernelLevel level)
+    {
+        if (!supported(level))
+        {
+            throw std::invalid_argument(std::string("Kernel level ") + name(level) + " is not supported on this machine.");
+        }
+        current().store(level, std::memory_order_relaxed);
+    }
+    const char *name(KernelLevel level)
+    {
+        switch (level)
+        {
+        case KernelLevel::avx2:
+            return "avx2";
+        case KernelLevel::avx512:
+            return "avx512";
+        default:
+            return "scalar";
+        }
+    }
+    const Kernels &active()
+    {
+        return table(level());
+    }
+}
@@ -0,0 +1,42 @@
+#pragma once
+#include <cstddef>
+namespace portfolio_optimizer::kernels
+{
+    enum class KernelLevel
+    {
+        scalar,
+        avx2,
+        avx512
+    };
+    //Hot loops compiled once per level, see kernel_bodies.hpp. Row-major storage throughout, packed symmetric
+    //matrices hold their lower triangle row by row (see optimization::SymmetricMatrix).
+    typedef struct
+    {
+        double (*dot)(const double *x, const double *y, size_t n);
+        //y += alpha * x
+        void (*axpy)(double alpha, const double *x, double *y, size_t n);
+        //Rows [first, last) of C = A * B, A is m x k and B is k x n
+        void (*gemm_rows)(const double *a, const double *b, double *c, size_t first, size_t last, size_t k, size_t n);
+        //C -= A * B^T, A is m x k, B is n x k and C is m x n
+        void (*rank_k_update)(const double *a, const double *b, double *c, size_t m, size_t k, size_t n);
+        //Rows [first, last) of Y = X * A, A packed symmetric n x n
+        void (*spmm_rows)(const double *x, const double *packed, double *y, size_t first, size_t last, size_t n);
+        //Packed A += alpha * x * x^T
+        void (*packed_rank_one_update)(double alpha, const double *x, double *packed, size_t n);
+        //Packed A += x * x^T - y * y^T in one pass
+        void (*packed_rank_two_update)(const double *x, const double *y, double *packed, size_t n);
+        //output[i - 1] = prices[i] / prices[i - 1] - 1 for i in [1, size), returns the sum and sum of squares of the returns
+        //minus shift. A shift near the mean keeps the variance from cancelling two large sums.
+        void (*simple_returns)(const double *prices, size_t size, double shift, double *output, double *sum, double *sum_squares);
+    } Kernels;
+    //Whether the build has the level and this CPU can run it
+    bool supported(KernelLevel level);
+    //Best supported level, or the one named by the PORTFOLIO_OPTIMIZER_KERNELS environment variable
+    //(scalar, avx2 or avx512) when it is set and supported. Chosen on first use.
+    KernelLevel level();
+    //Forces a level, e.g. for benchmarks. Throws std::invalid_argument when it is not supported.
+    //Variants round differently, so results move in the last bits when the level changes.
+    void set_level(KernelLevel level);
+    const char *name(KernelLevel level);
+    const Kernels &active();
+}
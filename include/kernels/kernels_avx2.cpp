@@ -0,0 +1,4 @@
+//Compiled with -mavx2 -mfma, only called once supported(KernelLevel::avx2) holds
+#define KERNEL_TABLE avx2_kernels
+#define KERNEL_WIDTH 4
+#include "kernel_bodies.hpp"
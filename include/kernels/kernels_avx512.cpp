@@ -0,0 +1,4 @@
+//Compiled with -mavx512f -mavx2 -mfma, only called once supported(KernelLevel::avx512) holds
+#define KERNEL_TABLE avx512_kernels
+#define KERNEL_WIDTH 8
+#include "kernel_bodies.hpp"
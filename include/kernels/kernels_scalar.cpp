@@ -0,0 +1,4 @@
+//Baseline build of the kernels, SSE2 vectors on x86-64
+#define KERNEL_TABLE scalar_kernels
+#define KERNEL_WIDTH 2
+#include "kernel_bodies.hpp"
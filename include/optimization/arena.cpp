@@ -0,0 +1,103 @@
+#include "arena.hpp"
+#include <cstdint>
+#include <algorithm>
+namespace portfolio_optimizer::optimization
+{
+    Arena::Arena(const size_t initial_size, std::pmr::memory_resource *upstream)
+    {
+        this->upstream = upstream;
+        add_block(std::max<size_t>(initial_size, 64));
+    }
+    Arena::~Arena()
+    {
+        for (const Block &block : blocks)
+        {
+            upstream->deallocate(block.data, block.size, alignof(std::max_align_t));
+        }
+    }
+    void Arena::add_block(size_t size)
+    {
+        blocks.push_back({static_cast<std::byte *>(upstream->allocate(size, alignof(std::max_align_t))), size});
+        allocations++;
+    }
+    void Arena::reset()
+    {
+        if (blocks.size() > 1)
+        {
+            size_t total = capacity();
+            for (const Block &block : blocks)
+            {
+                upstream->deallocate(block.data, block.size, alignof(std::max_align_t));
+            }
+            blocks.clear();
+            add_block(total);
+        }
+        current = 0;
+        offset = 0;
+        in_use = 0;
+    }
+    Arena::Mark Arena::mark() const
+    {
+        return {current, offset, in_use};
+    }
+    void Arena::rewind(const Mark &mark)
+    {
+        if (mark.current == 0 && mark.offset == 0)
+        {
+            reset();
+            return;
+        }
+        current = mark.current;
+        offset = mark.offset;
+        in_use = mark.in_use;
+    }
+    size_t Arena::capacity() const
+    {
+        size_t total = 0;
+        for (const Block &block : blocks)
+        {
+            total += block.size;
+        }
+        return total;
+    }
+    size_t Arena::used() const
+    {
+        return in_use;
+    }
+    size_t Arena::upstream_allocations() const
+    {
+        return allocations;
+    }
+    Arena &Arena::thread_local_arena()
+    {
+        thread_local Arena arena;
+        return arena;
+    }
+    void *Arena::do_allocate(size_t bytes, size_t alignment)
+    {
+        while (true)
+        {
+            Block &block = blocks[current];
+            size_t start = (reinterpret_cast<uintptr_t>(block.data) + offset + alignment - 1) / alignment * alignment - reinterpret_cast<uintptr_t>(block.data);
+            if (start + bytes <= block.size)
+            {
+                offset = start + bytes;
+                in_use += bytes;
+                return block.data + start;
+            }
+            if (current + 1 == blocks.size())
+            {
+                add_block(std::max(block.size * 2, bytes + alignment));
+            }
+            current++;
+            offset = 0;
+        }
+    }
+    void Arena::do_deallocate(void *, size_t, size_t)
+    {
+    }
+    bool Arena::do_is_equal(const std::pmr::memory_resource &other) const noexcept
+    {
+        return this == &other;
+    }
+}
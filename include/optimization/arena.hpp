@@ -0,0 +1,85 @@
+#pragma once
+#include "matrix.hpp"
+#include "symmetric_matrix.hpp"
+#include <vector>
+#include <cstddef>
+#include <memory_resource>
+namespace portfolio_optimizer::optimization
+{
+    //Monotonic memory resource for solver scratch. Deallocation is a no-op and reset() rewinds without returning
+    //memory, so once an arena has grown to a solve's high-water mark, later solves never reach the upstream allocator.
+    //Every object allocated from the arena must be gone before reset() or the arena's destruction. Code sharing an
+    //arena with its callers, like the thread-local one, takes an ArenaScope instead so it only rewinds its own allocations.
+    class Arena : public std::pmr::memory_resource
+    {
+    public:
+        //Position of the next allocation
+        struct Mark
+        {
+            size_t current;
+            size_t offset;
+            size_t in_use;
+        };
+        Arena(const size_t initial_size = 1 << 16, std::pmr::memory_resource *upstream = std::pmr::new_delete_resource());
+        Arena(const Arena &) = delete;
+        Arena &operator=(const Arena &) = delete;
+        ~Arena();
+        //Rewinds to the start. Blocks are merged into one as large as all of them, so steady state needs a single block.
+        void reset();
+        Mark mark() const;
+        //Rewinds to a mark taken earlier, allocations made since then must be gone. Rewinding to the start is a reset().
+        void rewind(const Mark &mark);
+        size_t capacity() const;
+        //Bytes handed out since the last reset
+        size_t used() const;
+        //Number of allocations made from the upstream resource over the arena's lifetime
+        size_t upstream_allocations() const;
+        //One arena per thread, so concurrent solves never contend on an allocator
+        static Arena &thread_local_arena();
+
+    protected:
+        void *do_allocate(size_t bytes, size_t alignment) override;
+        void do_deallocate(void *pointer, size_t bytes, size_t alignment) override;
+        bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override;
+
+    private:
+        struct Block
+        {
+            std::byte *data;
+            size_t size;
+        };
+        std::pmr::memory_resource *upstream;
+        std::vector<Block> blocks;
+        size_t current = 0;
+        size_t offset = 0;
+        size_t in_use = 0;
+        size_t allocations = 0;
+        void add_block(size_t size);
+    };
+    //Rewinds the arena to where it was on construction when it goes out of scope
+    class ArenaScope
+    {
+    private:
+        Arena &arena;
+        Arena::Mark start;
+
+    public:
+        ArenaScope(Arena &arena) : arena(arena), start(arena.mark())
+        {
+        }
+        ArenaScope(const ArenaScope &) = delete;
+        ArenaScope &operator=(const ArenaScope &) = delete;
+        ~ArenaScope()
+        {
+            arena.rewind(start);
+        }
+    };
+    template <typename T>
+    using ArenaAllocator = std::pmr::polymorphic_allocator<T>;
+    template <typename T>
+    using ArenaMatrix = Matrix<T, ArenaAllocator<T>>;
+    template <typename T>
+    using ArenaSymmetricMatrix = SymmetricMatrix<T, ArenaAllocator<T>>;
+    template <typename T>
+    using ArenaVector = std::pmr::vector<T>;
+}
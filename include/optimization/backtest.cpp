@@ -0,0 +1,265 @@
+#include "backtest.hpp"
+#include "cholesky.hpp"
+#include "covariance_accumulator.hpp"
+#include "frontier.hpp"
+#include "linear_algebra.hpp"
+#include <cmath>
+#include <atomic>
+#include <thread>
+#include <algorithm>
+#include <stdexcept>
+namespace portfolio_optimizer::optimization
+{
+    namespace
+    {
+        void multiply(const SymmetricMatrix<double> &matrix, const double *x, double *result)
+        {
+            spmv(matrix.values(), x, result, matrix.rows);
+        }
+        struct Workspace
+        {
+            std::vector<double> residual;
+            std::vector<double> preconditioned;
+            std::vector<double> direction;
+            std::vector<double> product;
+        };
+        //Conjugate gradient on matrix * x = b starting from x, preconditioned with a factorization of a
+        //nearby matrix. Returns the iterations used, or max_iterations + 1 when it did not converge.
+        size_t preconditioned_conjugate_gradient(const SymmetricMatrix<double> &matrix, const Cholesky<double> &preconditioner, const std::vector<double> &b,
+                                                 std::vector<double> &x, Workspace &workspace, size_t max_iterations, double tolerance)
+        {
+            size_t n = b.size();
+            workspace.residual.resize(n);
+            workspace.preconditioned.resize(n);
+            workspace.direction.resize(n);
+            workspace.product.resize(n);
+            double *r = workspace.residual.data();
+            double *z = workspace.preconditioned.data();
+            double *p = workspace.direction.data();
+            double *q = workspace.product.data();
+            multiply(matrix, x.data(), q);
+            for (size_t i = 0; i < n; i++)
+            {
+                r[i] = b[i] - q[i];
+            }
+            double threshold = tolerance * std::sqrt(dot(b.data(), b.data(), n));
+            std::copy(r, r + n, z);
+            preconditioner.solve(z);
+            std::copy(z, z + n, p);
+            double rz = dot(r, z, n);
+            for (size_t iteration = 0; iteration <= max_iterations; iteration++)
+            {
+                if (std::sqrt(dot(r, r, n)) <= threshold)
+                {
+                    return iteration;
+                }
+                if (iteration == max_iterations)
+                {
+                    break;
+                }
+                multiply(matrix, p, q);
+                double alpha = rz / dot(p, q, n);
+                for (size_t i = 0; i < n; i++)
+                {
+                    x[i] += alpha * p[i];
+                    r[i] -= alpha * q[i];
+                }
+                std::copy(r, r + n, z);
+                preconditioner.solve(z);
+                double rz_next = dot(r, z, n);
+                double beta = rz_next / rz;
+                rz = rz_next;
+                for (size_t i = 0; i < n; i++)
+                {
+                    p[i] = z[i] + beta * p[i];
+                }
+            }
+            return max_iterations + 1;
+        }
+    }
+    Backtest::Backtest(const std::vector<std::string> &tickers, const std::unordered_map<std::string, std::vector<double>> &historical_returns)
+    {
+        if (tickers.empty())
+        {
+            throw std::invalid_argument("At least one ticker is needed.");
+        }
+        size_t periods = historical_returns.at(tickers[0]).size();
+        this->tickers = tickers;
+        this->returns = Matrix<double>(periods, tickers.size());
+        for (size_t j = 0; j < tickers.size(); j++)
+        {
+            const std::vector<double> &series = historical_returns.at(tickers[j]);
+            if (series.size() != periods)
+            {
+                throw std::invalid_argument("Every ticker must have the same number of returns.");
+            }
+            for (size_t i = 0; i < periods; i++)
+            {
+                returns(i, j) = series[i];
+            }
+        }
+    }
+    Backtest::Backtest(const std::vector<std::string> &tickers, const Matrix<double> &returns)
+    {
+        if (returns.cols != tickers.size())
+        {
+            throw std::invalid_argument("Matrix dimensions must agree.");
+        }
+        this->tickers = tickers;
+        this->returns = returns;
+    }
+    const std::vector<std::string> &Backtest::get_tickers() const
+    {
+        return tickers;
+    }
+    BacktestResult Backtest::run(const BacktestConfig &config, size_t factor_threads) const
+    {
+        const size_t periods = returns.rows;
+        const size_t assets = returns.cols;
+        if (config.window < 2 || config.window >= periods)
+        {
+            throw std::invalid_argument("Window must be between 2 and the number of periods.");
+        }
+        if (config.rebalance_every == 0)
+        {
+            throw std::invalid_argument("Rebalance interval must be positive.");
+        }
+        BacktestResult result;
+        result.config = config;
+        CovarianceAccumulator accumulator(assets);
+        for (size_t t = 0; t < config.window; t++)
+        {
+            accumulator.add(returns.values() + t * assets);
+        }
+        SymmetricMatrix<double> covariance(assets);
+        Cholesky<double> factor;
+        bool factored = false;
+        Workspace workspace;
+        const std::vector<double> ones(assets, 1.0);
+        std::vector<double> inverse_ones(assets, 0.0);
+        std::vector<double> inverse_returns(assets, 0.0);
+        std::vector<double> held(assets, 0.0);
+        std::vector<double> target(assets);
+        double value = 1;
+        for (size_t t = config.window; t < periods; t++)
+        {
+            if ((t - config.window) % config.rebalance_every == 0)
+            {
+                accumulator.covariance(covariance);
+                std::vector<double> expected_returns = accumulator.mean();
+                bool converged = factored;
+                if (converged)
+                {
+                    size_t iterations = preconditioned_conjugate_gradient(covariance, factor, ones, inverse_ones, workspace, config.max_iterations, config.tolerance);
+                    converged = iterations <= config.max_iterations;
+                    result.solver_iterations += std::min(iterations, config.max_iterations);
+                }
+                if (converged && config.target_return.has_value())
+                {
+                    size_t iterations = preconditioned_conjugate_gradient(covariance, factor, expected_returns, inverse_returns, workspace, config.max_iterations, config.tolerance);
+                    converged = iterations <= config.max_iterations;
+                    result.solver_iterations += std::min(iterations, config.max_iterations);
+                }
+                if (!converged)
+                {
+                    factor.factor(covariance, factor_threads);
+                    factored = true;
+                    result.factorizations++;
+                    inverse_ones = factor.solve(ones);
+                    if (config.target_return.has_value())
+                    {
+                        inverse_returns = factor.solve(expected_returns);
+                    }
+                }
+                FrontierSolution frontier(inverse_ones, inverse_returns, expected_returns);
+                if (config.target_return.has_value())
+                {
+                    frontier.weights(config.target_return.value() / config.periods_per_year, target.data());
+                }
+                else
+                {
+                    frontier.minimum_variance_weights(target.data());
+                }
+                double turnover = 0;
+                for (size_t i = 0; i < assets; i++)
+                {
+                    turnover += std::abs(target[i] - held[i]);
+                }
+                held = target;
+                result.rebalance_periods.push_back(t);
+                result.weights.push_back(target);
+                result.turnover.push_back(turnover);
+                result.total_turnover += turnover;
+            }
+            const double *row = returns.values() + t * assets;
+            double portfolio_return = dot(held.data(), row, assets);
+            value *= 1 + portfolio_return;
+            result.portfolio_returns.push_back(portfolio_return);
+            result.portfolio_values.push_back(value);
+            //Weights drift with their assets until the next rebalance
+            for (size_t i = 0; i < assets; i++)
+            {
+                held[i] = held[i] * (1 + row[i]) / (1 + portfolio_return);
+            }
+            accumulator.replace(row, returns.values() + (t - config.window) * assets);
+        }
+        size_t count = result.portfolio_returns.size();
+        double mean = 0;
+        for (size_t i = 0; i < count; i++)
+        {
+            mean += result.portfolio_returns[i];
+        }
+        mean /= count;
+        double variance = 0;
+        for (size_t i = 0; i < count; i++)
+        {
+            variance += (result.portfolio_returns[i] - mean) * (result.portfolio_returns[i] - mean);
+        }
+        variance = count > 1 ? variance / (count - 1) : 0;
+        result.realized_return = mean * config.periods_per_year;
+        result.realized_volatility = std::sqrt(variance * config.periods_per_year);
+        return result;
+    }
+    std::vector<BacktestResult> Backtest::run(const std::vector<BacktestConfig> &configs, size_t threads) const
+    {
+        if (threads == 0)
+        {
+            threads = std::max<size_t>(1, std::thread::hardware_concurrency());
+        }
+        threads = std::max<size_t>(1, std::min(threads, configs.size()));
+        std::vector<BacktestResult> results(configs.size());
+        std::vector<std::exception_ptr> errors(configs.size());
+        std::atomic<size_t> next = 0;
+        std::vector<std::thread> workers(threads);
+        for (size_t t = 0; t < threads; t++)
+        {
+            workers[t] = std::thread([&]()
+            {
+                for (size_t i = next++; i < configs.size(); i = next++)
+                {
+                    try
+                    {
+                        //Configurations already share the threads, so factorizations stay on their worker
+                        results[i] = run(configs[i], threads == 1 ? 0 : 1);
+                    }
+                    catch (...)
+                    {
+                        errors[i] = std::current_exception();
+                    }
+                }
+            });
+        }
+        for (size_t t = 0; t < threads; t++)
+        {
+            workers[t].join();
+        }
+        for (size_t i = 0; i < errors.size(); i++)
+        {
+            if (errors[i])
+            {
+                std::rethrow_exception(errors[i]);
+            }
+        }
+        return results;
+    }
+}
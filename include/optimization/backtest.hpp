@@ -0,0 +1,56 @@
+#pragma once
+#include "matrix.hpp"
+#include <vector>
+#include <string>
+#include <optional>
+#include <unordered_map>
+namespace portfolio_optimizer::optimization
+{
+    struct BacktestConfig
+    {
+        //Number of periods used to estimate the moments at every rebalance
+        size_t window = 252;
+        size_t rebalance_every = 21;
+        //Annualised target return, the global minimum variance portfolio is held when empty
+        std::optional<double> target_return;
+        double periods_per_year = 252;
+        //Preconditioned conjugate gradient iterations allowed on the previous factorization before refactoring
+        size_t max_iterations = 25;
+        double tolerance = 1e-8;
+    };
+    struct BacktestResult
+    {
+        BacktestConfig config;
+        //Period index and target weights of every rebalance
+        std::vector<size_t> rebalance_periods;
+        std::vector<std::vector<double>> weights;
+        //Sum of absolute weight changes against the drifted portfolio at every rebalance
+        std::vector<double> turnover;
+        //One entry per period from the first rebalance on
+        std::vector<double> portfolio_returns;
+        std::vector<double> portfolio_values;
+        double realized_return = 0;
+        double realized_volatility = 0;
+        double total_turnover = 0;
+        size_t factorizations = 0;
+        size_t solver_iterations = 0;
+    };
+    //Walks a returns history, keeps the window's covariance up to date with rank-one additions and
+    //removals and warm-starts each rebalance's solve from the previous weights and factorization.
+    class Backtest
+    {
+    private:
+        std::vector<std::string> tickers;
+        //periods x assets
+        Matrix<double> returns;
+
+    public:
+        Backtest(const std::vector<std::string> &tickers, const std::unordered_map<std::string, std::vector<double>> &historical_returns);
+        Backtest(const std::vector<std::string> &tickers, const Matrix<double> &returns);
+        const std::vector<std::string> &get_tickers() const;
+        //Large covariances are factored on factor_threads threads, 0 uses every hardware thread
+        BacktestResult run(const BacktestConfig &config, size_t factor_threads = 0) const;
+        //Independent configurations run in parallel, threads = 0 uses every hardware thread
+        std::vector<BacktestResult> run(const std::vector<BacktestConfig> &configs, size_t threads = 0) const;
+    };
+}
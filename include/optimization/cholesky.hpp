@@ -0,0 +1,293 @@
+#pragma once
+#include "matrix.hpp"
+#include "symmetric_matrix.hpp"
+#include "tiled_cholesky.hpp"
+#include "linear_algebra.hpp"
+#include <vector>
+#include <cmath>
+#include <algorithm>
+#include <type_traits>
+#include <stdexcept>
+namespace portfolio_optimizer::optimization
+{
+    //Cholesky factorization A = L * L^T of a symmetric positive definite matrix.
+    //L is kept packed row by row like SymmetricMatrix, so every inner product runs over two contiguous row prefixes,
+    //the factor takes half the memory of a dense one and lives in Allocator's memory.
+    //Double matrices from tiled_cholesky_threshold on are factored by tiled_cholesky on factor's threads, every hardware
+    //thread by default. Callers that already run on a worker thread pass 1 so pools do not nest.
+    template <typename T, typename Allocator = std::allocator<T>>
+    class Cholesky
+    {
+    private:
+        size_t n = 0;
+        std::vector<T, Allocator> L;
+        //Inner products and updates over row prefixes, double factors use the dispatched kernels
+        static T inner(const T *x, const T *y, const size_t count)
+        {
+            if constexpr (std::is_same_v<T, double>)
+            {
+                return dot(x, y, count);
+            }
+            else
+            {
+                T sum = 0;
+                for (size_t k = 0; k < count; k++)
+                {
+                    sum += x[k] * y[k];
+                }
+                return sum;
+            }
+        }
+        static void subtract(const T alpha, const T *x, T *y, const size_t count)
+        {
+            if constexpr (std::is_same_v<T, double>)
+            {
+                axpy(-alpha, x, y, count);
+            }
+            else
+            {
+                for (size_t k = 0; k < count; k++)
+                {
+                    y[k] -= alpha * x[k];
+                }
+            }
+        }
+        //lower(i, j) returns entry (i, j) of the matrix for j <= i
+        template <typename Lower>
+        void factor_lower(const size_t size, Lower lower, const size_t threads)
+        {
+            n = size;
+            L.resize(SymmetricMatrix<T, Allocator>::packed_size(n));
+            T *l = L.data();
+            if constexpr (std::is_same_v<T, double>)
+            {
+                if (n >= tiled_cholesky_threshold)
+                {
+                    for (size_t i = 0; i < n; i++)
+                    {
+                        T *row = l + SymmetricMatrix<T, Allocator>::offset(i);
+                        for (size_t j = 0; j <= i; j++)
+                        {
+                            row[j] = lower(i, j);
+                        }
+                    }
+                    tiled_cholesky(l, n, threads);
+                    return;
+                }
+            }
+            for (size_t i = 0; i < n; i++)
+            {
+                T *row_i = l + SymmetricMatrix<T, Allocator>::offset(i);
+                for (size_t j = 0; j <= i; j++)
+                {
+                    const T *row_j = l + SymmetricMatrix<T, Allocator>::offset(j);
+                    T sum = lower(i, j) - inner(row_i, row_j, j);
+                    if (i == j)
+                    {
+                        if (!(sum > 0))
+                        {
+                            throw std::invalid_argument("Matrix must be positive definite.");
+                        }
+                        row_i[i] = std::sqrt(sum);
+                    }
+                    else
+                    {
+                        row_i[j] = sum / row_j[j];
+                    }
+                }
+            }
+        }
+
+        //Rank-one update (sign = 1) or downdate (sign = -1) of the trailing block of L from row and column first on,
+        //x holds that block's part of the vector. The Givens rotations of the columns are applied row by row, so every
+        //row is touched once and contiguously; column k's rotation is known by the time a later row needs it.
+        void rotate(T *x, const T sign, const size_t first)
+        {
+            const size_t m = n - first;
+            std::vector<T> cosines(m);
+            std::vector<T> sines(m);
+            for (size_t i = 0; i < m; i++)
+            {
+                T *row = L.data() + SymmetricMatrix<T, Allocator>::offset(first + i) + first;
+                T value = x[i];
+                for (size_t k = 0; k < i; k++)
+                {
+                    T updated = (row[k] + sign * sines[k] * value) / cosines[k];
+                    value = cosines[k] * value - sines[k] * updated;
+                    row[k] = updated;
+                }
+                T diagonal = row[i];
+                T squared = diagonal * diagonal + sign * value * value;
+                if (!(squared > 0))
+                {
+                    throw std::invalid_argument("Matrix must be positive definite.");
+                }
+                T root = std::sqrt(squared);
+                cosines[i] = root / diagonal;
+                sines[i] = value / diagonal;
+                row[i] = root;
+            }
+        }
+
+    public:
+        Cholesky(const Allocator &allocator = Allocator()) : L(allocator)
+        {
+        }
+        template <typename MatrixAllocator>
+        Cholesky(const Matrix<T, MatrixAllocator> &matrix, const Allocator &allocator = Allocator()) : L(allocator)
+        {
+            factor(matrix);
+        }
+        template <typename MatrixAllocator>
+        Cholesky(const SymmetricMatrix<T, MatrixAllocator> &matrix, const Allocator &allocator = Allocator()) : L(allocator)
+        {
+            factor(matrix);
+        }
+        //Only the lower triangle of matrix is read. threads = 0 uses every hardware thread for large double matrices
+        template <typename MatrixAllocator>
+        void factor(const Matrix<T, MatrixAllocator> &matrix, const size_t threads = 0)
+        {
+            if (matrix.rows != matrix.cols)
+            {
+                throw std::invalid_argument("Matrix must be square.");
+            }
+            const T *a = matrix.values();
+            const size_t cols = matrix.cols;
+            factor_lower(matrix.rows, [a, cols](size_t i, size_t j) { return a[i * cols + j]; }, threads);
+        }
+        template <typename MatrixAllocator>
+        void factor(const SymmetricMatrix<T, MatrixAllocator> &matrix, const size_t threads = 0)
+        {
+            const T *a = matrix.values();
+            factor_lower(matrix.rows, [a](size_t i, size_t j) { return a[SymmetricMatrix<T, MatrixAllocator>::offset(i) + j]; }, threads);
+        }
+        //Borders the factored matrix with one more row and column: row holds the new entry's covariances with the
+        //existing ones followed by its own diagonal entry. One forward substitution, O(N^2).
+        void append(const T *row)
+        {
+            std::vector<T> l(row, row + n);
+            T diagonal = row[n];
+            for (size_t i = 0; i < n; i++)
+            {
+                const T *factor_row = L.data() + SymmetricMatrix<T, Allocator>::offset(i);
+                l[i] = (l[i] - inner(factor_row, l.data(), i)) / factor_row[i];
+                diagonal -= l[i] * l[i];
+            }
+            if (!(diagonal > 0))
+            {
+                throw std::invalid_argument("Matrix must be positive definite.");
+            }
+            L.resize(SymmetricMatrix<T, Allocator>::packed_size(n + 1));
+            T *new_row = L.data() + SymmetricMatrix<T, Allocator>::offset(n);
+            std::copy(l.begin(), l.end(), new_row);
+            new_row[n] = std::sqrt(diagonal);
+            n++;
+        }
+        //Drops row and column index from the factored matrix. The rows after index lose their entry in column index,
+        //which comes back as a rank-one update of the trailing block, O(N^2).
+        void remove(const size_t index)
+        {
+            if (index >= n)
+            {
+                throw std::invalid_argument("Row or column index out of bounds.");
+            }
+            std::vector<T> column(n - index - 1);
+            T *l = L.data();
+            for (size_t i = index + 1; i < n; i++)
+            {
+                //Packed rows only move towards the front, onto rows already moved
+                const T *source = l + SymmetricMatrix<T, Allocator>::offset(i);
+                T *destination = l + SymmetricMatrix<T, Allocator>::offset(i - 1);
+                column[i - index - 1] = source[index];
+                std::copy(source, source + index, destination);
+                std::copy(source + index + 1, source + i + 1, destination + index);
+            }
+            n--;
+            L.resize(SymmetricMatrix<T, Allocator>::packed_size(n));
+            rotate(column.data(), 1, index);
+        }
+        //Factor of A + alpha * x * x^T, O(N^2). A downdate that would leave the matrix indefinite throws and keeps the old factor.
+        void update(const T *x, const T alpha)
+        {
+            std::vector<T> scaled(x, x + n);
+            T scale = std::sqrt(std::abs(alpha));
+            for (size_t i = 0; i < n; i++)
+            {
+                scaled[i] *= scale;
+            }
+            if (alpha >= 0)
+            {
+                rotate(scaled.data(), 1, 0);
+                return;
+            }
+            std::vector<T, Allocator> previous = L;
+            try
+            {
+                rotate(scaled.data(), -1, 0);
+            }
+            catch (...)
+            {
+                L = std::move(previous);
+                throw;
+            }
+        }
+        size_t size() const
+        {
+            return n;
+        }
+        //Packed rows of L, row i starts at values() + SymmetricMatrix<T>::offset(i)
+        const T *values() const
+        {
+            return L.data();
+        }
+        T *values()
+        {
+            return L.data();
+        }
+        Matrix<T, Allocator> lower() const
+        {
+            Matrix<T, Allocator> result(n, n, L.get_allocator());
+            for (size_t i = 0; i < n; i++)
+            {
+                const T *row = L.data() + SymmetricMatrix<T, Allocator>::offset(i);
+                std::copy(row, row + i + 1, result.values() + i * n);
+            }
+            return result;
+        }
+        //Solves L * L^T * x = b in place
+        void solve(T *x) const
+        {
+            const T *l = L.data();
+            for (size_t i = 0; i < n; i++)
+            {
+                const T *row = l + SymmetricMatrix<T, Allocator>::offset(i);
+                x[i] = (x[i] - inner(row, x, i)) / row[i];
+            }
+            for (size_t i = n; i-- > 0;)
+            {
+                const T *row = l + SymmetricMatrix<T, Allocator>::offset(i);
+                x[i] /= row[i];
+                subtract(x[i], row, x, i);
+            }
+        }
+        std::vector<T> solve(const std::vector<T> &b) const
+        {
+            if (b.size() != n)
+            {
+                throw std::invalid_argument("Vector size must be equal to number of rows.");
+            }
+            std::vector<T> x = b;
+            solve(x.data());
+            return x;
+        }
+        T log_determinant() const
+        {
+            T result = 0;
+            for (size_t i = 0; i < n; i++)
+            {
+                result += 2 * std::log(L[SymmetricMatrix<T, Allocator>::offset(i) + i]);
+            }
+            return result;
+        }
+    };
+}
@@ -0,0 +1,157 @@
+#include "covariance_accumulator.hpp"
+#include "linear_algebra.hpp"
+#include <algorithm>
+#include <stdexcept>
+namespace portfolio_optimizer::optimization
+{
+    CovarianceAccumulator::CovarianceAccumulator()
+    {
+    }
+    CovarianceAccumulator::CovarianceAccumulator(const size_t assets)
+    {
+        this->assets = assets;
+        this->shift.resize(assets);
+        this->centred.resize(2 * assets);
+        this->sums.resize(assets);
+        this->cross_products = SymmetricMatrix<double>(assets);
+    }
+    const double *CovarianceAccumulator::shifted(const double *row, double *result)
+    {
+        for (size_t i = 0; i < assets; i++)
+        {
+            result[i] = row[i] - shift[i];
+        }
+        return result;
+    }
+    void CovarianceAccumulator::add(const double *row)
+    {
+        if (observations == 0)
+        {
+            std::copy(row, row + assets, shift.begin());
+        }
+        const double *x = shifted(row, centred.data());
+        for (size_t i = 0; i < assets; i++)
+        {
+            sums[i] += x[i];
+        }
+        packed_rank_one_update(1, x, cross_products.values(), assets);
+        observations++;
+    }
+    void CovarianceAccumulator::remove(const double *row)
+    {
+        if (observations == 0)
+        {
+            throw std::invalid_argument("No observations to remove.");
+        }
+        if (--observations == 0)
+        {
+            clear();
+            return;
+        }
+        const double *x = shifted(row, centred.data());
+        for (size_t i = 0; i < assets; i++)
+        {
+            sums[i] -= x[i];
+        }
+        packed_rank_one_update(-1, x, cross_products.values(), assets);
+    }
+    void CovarianceAccumulator::replace(const double *added, const double *removed)
+    {
+        if (observations == 0)
+        {
+            throw std::invalid_argument("No observations to remove.");
+        }
+        const double *x = shifted(added, centred.data());
+        const double *y = shifted(removed, centred.data() + assets);
+        for (size_t i = 0; i < assets; i++)
+        {
+            sums[i] += x[i] - y[i];
+        }
+        packed_rank_two_update(x, y, cross_products.values(), assets);
+    }
+    void CovarianceAccumulator::merge(const CovarianceAccumulator &other)
+    {
+        if (other.assets != assets)
+        {
+            throw std::invalid_argument("Accumulators must have the same number of assets.");
+        }
+        if (other.observations == 0)
+        {
+            return;
+        }
+        if (observations == 0)
+        {
+            *this = other;
+            return;
+        }
+        //Moves other's moments onto this shift: x - shift = (x - other.shift) + d
+        std::vector<double> d(assets);
+        for (size_t i = 0; i < assets; i++)
+        {
+            d[i] = other.shift[i] - shift[i];
+        }
+        const double n = static_cast<double>(other.observations);
+        for (size_t i = 0; i < assets; i++)
+        {
+            const double *other_row = other.cross_products.row(i);
+            double *row = cross_products.row(i);
+            for (size_t j = 0; j <= i; j++)
+            {
+                row[j] += other_row[j] + other.sums[i] * d[j] + d[i] * other.sums[j] + n * d[i] * d[j];
+            }
+        }
+        for (size_t i = 0; i < assets; i++)
+        {
+            sums[i] += other.sums[i] + n * d[i];
+        }
+        observations += other.observations;
+    }
+    void CovarianceAccumulator::clear()
+    {
+        *this = CovarianceAccumulator(assets);
+    }
+    size_t CovarianceAccumulator::size() const
+    {
+        return assets;
+    }
+    size_t CovarianceAccumulator::count() const
+    {
+        return observations;
+    }
+    std::vector<double> CovarianceAccumulator::mean() const
+    {
+        std::vector<double> result(assets);
+        for (size_t i = 0; i < assets; i++)
+        {
+            result[i] = observations > 0 ? shift[i] + sums[i] / observations : 0;
+        }
+        return result;
+    }
+    SymmetricMatrix<double> CovarianceAccumulator::covariance() const
+    {
+        SymmetricMatrix<double> result(assets);
+        covariance(result);
+        return result;
+    }
+    void CovarianceAccumulator::covariance(SymmetricMatrix<double> &result) const
+    {
+        if (observations < 2)
+        {
+            throw std::invalid_argument("At least two observations are needed.");
+        }
+        if (result.rows != assets)
+        {
+            result = SymmetricMatrix<double>(assets);
+        }
+        double n = static_cast<double>(observations);
+        for (size_t i = 0; i < assets; i++)
+        {
+            const double *cross_row = cross_products.row(i);
+            double *row = result.row(i);
+            for (size_t j = 0; j <= i; j++)
+            {
+                row[j] = (cross_row[j] - sums[i] * sums[j] / n) / (n - 1);
+            }
+        }
+    }
+}
@@ -0,0 +1,38 @@
+#pragma once
+#include "symmetric_matrix.hpp"
+#include <vector>
+namespace portfolio_optimizer::optimization
+{
+    //Running sums and cross-products of return observations. Rows can be added and removed,
+    //so a rolling window only pays for the observations entering and leaving it.
+    //Both are taken about a shift, the first row added to the empty accumulator, so they stay of the order of the
+    //spread rather than the level. That keeps low-variance assets from cancelling two large terms in covariance() and
+    //keeps the rounding left behind by removed rows small. An accumulator emptied by remove() starts over exactly.
+    class CovarianceAccumulator
+    {
+    private:
+        size_t assets = 0;
+        size_t observations = 0;
+        std::vector<double> shift;
+        //Scratch for a shifted row
+        std::vector<double> centred;
+        std::vector<double> sums;
+        SymmetricMatrix<double> cross_products;
+        const double *shifted(const double *row, double *result);
+
+    public:
+        CovarianceAccumulator();
+        CovarianceAccumulator(const size_t assets);
+        void add(const double *row);
+        void remove(const double *row);
+        //Adds one row and removes another in a single pass, as a rolling window does
+        void replace(const double *added, const double *removed);
+        void merge(const CovarianceAccumulator &other);
+        void clear();
+        size_t size() const;
+        size_t count() const;
+        std::vector<double> mean() const;
+        SymmetricMatrix<double> covariance() const;
+        void covariance(SymmetricMatrix<double> &result) const;
+    };
+}
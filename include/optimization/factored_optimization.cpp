@@ -0,0 +1,106 @@
+#include "factored_optimization.hpp"
+#include "risk.hpp"
+#include <cmath>
+#include <algorithm>
+#include <stdexcept>
+namespace portfolio_optimizer::optimization
+{
+    FactoredOptimization::FactoredOptimization(const std::vector<std::string> &tickers, const std::vector<double> &expected_returns, const SymmetricMatrix<double> &covariance_matrix,
+                                               const double risk_free_rate)
+    {
+        if (tickers.size() != expected_returns.size() || tickers.size() != covariance_matrix.rows)
+        {
+            throw std::invalid_argument("Number of tickers, expected returns and covariance rows must agree.");
+        }
+        this->tickers = tickers;
+        this->expected_returns = expected_returns;
+        this->covariance_matrix = covariance_matrix;
+        this->risk_free_rate = risk_free_rate;
+        factor.factor(covariance_matrix);
+        frontier = FrontierSolution(factor, expected_returns);
+    }
+    size_t FactoredOptimization::index_of(const std::string &ticker) const
+    {
+        auto found = std::find(tickers.begin(), tickers.end(), ticker);
+        if (found == tickers.end())
+        {
+            throw std::invalid_argument("Unknown ticker " + ticker + ".");
+        }
+        return found - tickers.begin();
+    }
+    void FactoredOptimization::add_asset(const std::string &ticker, const double expected_return, const std::vector<double> &covariances)
+    {
+        if (std::find(tickers.begin(), tickers.end(), ticker) != tickers.end())
+        {
+            throw std::invalid_argument("Ticker " + ticker + " is already in the universe.");
+        }
+        if (covariances.size() != tickers.size() + 1)
+        {
+            throw std::invalid_argument("Covariances must hold one entry per ticker and the new variance.");
+        }
+        //The factor throws before changing when the bordered covariance is not positive definite
+        factor.append(covariances.data());
+        covariance_matrix.append(covariances.data());
+        tickers.push_back(ticker);
+        expected_returns.push_back(expected_return);
+        frontier = FrontierSolution(factor, expected_returns);
+    }
+    void FactoredOptimization::remove_asset(const std::string &ticker)
+    {
+        size_t index = index_of(ticker);
+        factor.remove(index);
+        covariance_matrix.remove(index);
+        tickers.erase(tickers.begin() + index);
+        expected_returns.erase(expected_returns.begin() + index);
+        frontier = FrontierSolution(factor, expected_returns);
+    }
+    void FactoredOptimization::update_covariance(const std::vector<double> &x, const double alpha)
+    {
+        if (x.size() != tickers.size())
+        {
+            throw std::invalid_argument("Vector size must be equal to number of tickers.");
+        }
+        factor.update(x.data(), alpha);
+        covariance_matrix.update(x.data(), alpha);
+        frontier = FrontierSolution(factor, expected_returns);
+    }
+    const std::vector<std::string> &FactoredOptimization::get_tickers() const
+    {
+        return tickers;
+    }
+    const std::vector<double> &FactoredOptimization::get_expected_returns() const
+    {
+        return expected_returns;
+    }
+    const SymmetricMatrix<double> &FactoredOptimization::get_covariance_matrix() const
+    {
+        return covariance_matrix;
+    }
+    OptimizationResult FactoredOptimization::minimum_risk(const double wanted_return) const
+    {
+        std::vector<double> weights = frontier.weights(wanted_return);
+        RiskDecomposition decomposition = decompose_risk(covariance_matrix, weights);
+        OptimizationResult result;
+        result.expected_return = wanted_return;
+        result.leverage = 0;
+        for (size_t i = 0; i < tickers.size(); i++)
+        {
+            result.weights[tickers[i]] = weights[i];
+            result.covariance_contributions[tickers[i]] = decomposition.component[i];
+            result.leverage += std::abs(weights[i]);
+        }
+        result.volatility = decomposition.volatility;
+        result.sharpe_ratio = (result.expected_return - risk_free_rate) / result.volatility;
+        result.lagrange_multipliers = frontier.lagrange_multipliers(wanted_return);
+        return result;
+    }
+    std::vector<OptimizationResult> FactoredOptimization::minimum_risk(const std::vector<double> &wanted_returns) const
+    {
+        std::vector<OptimizationResult> results(wanted_returns.size());
+        for (size_t i = 0; i < wanted_returns.size(); i++)
+        {
+            results[i] = minimum_risk(wanted_returns[i]);
+        }
+        return results;
+    }
+}
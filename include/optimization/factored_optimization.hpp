@@ -0,0 +1,39 @@
+#pragma once
+#include "optimization.hpp"
+#include "symmetric_matrix.hpp"
+#include "cholesky.hpp"
+#include "frontier.hpp"
+#include <vector>
+#include <string>
+namespace portfolio_optimizer::optimization
+{
+    //Minimum variance frontier of a universe that keeps its covariance factored between edits.
+    //Adding an asset borders the factor, removing one or changing the covariance by a rank-one term updates it,
+    //each in O(N^2) instead of the O(N^3) of factoring again. Copy the object to explore a what-if without
+    //touching the base universe, that copy is O(N^2) as well.
+    class FactoredOptimization
+    {
+    private:
+        std::vector<std::string> tickers;
+        std::vector<double> expected_returns;
+        SymmetricMatrix<double> covariance_matrix;
+        Cholesky<double> factor;
+        FrontierSolution frontier;
+        double risk_free_rate = 0;
+        size_t index_of(const std::string &ticker) const;
+
+    public:
+        FactoredOptimization(const std::vector<std::string> &tickers, const std::vector<double> &expected_returns, const SymmetricMatrix<double> &covariance_matrix, const double risk_free_rate = 0);
+        //covariances holds the new asset's covariance with every current ticker, in tickers() order, followed by its variance
+        void add_asset(const std::string &ticker, const double expected_return, const std::vector<double> &covariances);
+        void remove_asset(const std::string &ticker);
+        //covariance += alpha * x * x^T, x in tickers() order. A negative alpha that would leave the covariance
+        //indefinite throws and keeps the current state.
+        void update_covariance(const std::vector<double> &x, const double alpha = 1);
+        const std::vector<std::string> &get_tickers() const;
+        const std::vector<double> &get_expected_returns() const;
+        const SymmetricMatrix<double> &get_covariance_matrix() const;
+        OptimizationResult minimum_risk(const double wanted_return) const;
+        std::vector<OptimizationResult> minimum_risk(const std::vector<double> &wanted_returns) const;
+    };
+}
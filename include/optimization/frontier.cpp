@@ -0,0 +1,87 @@
+#include "frontier.hpp"
+#include <stdexcept>
+namespace portfolio_optimizer::optimization
+{
+    FrontierSolution::FrontierSolution()
+    {
+    }
+    FrontierSolution::FrontierSolution(const std::vector<double> &inverse_ones, const std::vector<double> &inverse_returns, const std::vector<double> &expected_returns)
+    {
+        if (inverse_ones.size() != expected_returns.size() || inverse_returns.size() != expected_returns.size())
+        {
+            throw std::invalid_argument("Vector sizes must agree.");
+        }
+        this->inverse_ones.assign(inverse_ones.begin(), inverse_ones.end());
+        this->inverse_returns.assign(inverse_returns.begin(), inverse_returns.end());
+        finish(expected_returns.data());
+    }
+    FrontierSolution::FrontierSolution(const Cholesky<double> &factor, const std::vector<double> &expected_returns)
+    {
+        if (factor.size() != expected_returns.size())
+        {
+            throw std::invalid_argument("Vector sizes must agree.");
+        }
+        *this = FrontierSolution(factor, expected_returns.data(), std::pmr::get_default_resource());
+    }
+    void FrontierSolution::finish(const double *expected_returns)
+    {
+        a = 0;
+        b = 0;
+        c = 0;
+        for (size_t i = 0; i < inverse_ones.size(); i++)
+        {
+            a += inverse_ones[i];
+            b += inverse_returns[i];
+            c += expected_returns[i] * inverse_returns[i];
+        }
+        d = a * c - b * b;
+    }
+    size_t FrontierSolution::size() const
+    {
+        return inverse_ones.size();
+    }
+    void FrontierSolution::weights(const double target_return, double *result) const
+    {
+        if (d <= 0)
+        {
+            throw std::invalid_argument("Expected returns must not all be equal.");
+        }
+        double lambda_returns = (a * target_return - b) / d;
+        double lambda_ones = (c - b * target_return) / d;
+        for (size_t i = 0; i < inverse_ones.size(); i++)
+        {
+            result[i] = lambda_returns * inverse_returns[i] + lambda_ones * inverse_ones[i];
+        }
+    }
+    std::vector<double> FrontierSolution::weights(const double target_return) const
+    {
+        std::vector<double> result(inverse_ones.size());
+        weights(target_return, result.data());
+        return result;
+    }
+    void FrontierSolution::minimum_variance_weights(double *result) const
+    {
+        for (size_t i = 0; i < inverse_ones.size(); i++)
+        {
+            result[i] = inverse_ones[i] / a;
+        }
+    }
+    std::vector<double> FrontierSolution::minimum_variance_weights() const
+    {
+        std::vector<double> result(inverse_ones.size());
+        minimum_variance_weights(result.data());
+        return result;
+    }
+    double FrontierSolution::minimum_variance_return() const
+    {
+        return b / a;
+    }
+    double FrontierSolution::variance(const double target_return) const
+    {
+        return (a * target_return * target_return - 2 * b * target_return + c) / d;
+    }
+    std::vector<double> FrontierSolution::lagrange_multipliers(const double target_return) const
+    {
+        return {-2 * (a * target_return - b) / d, -2 * (c - b * target_return) / d};
+    }
+}
@@ -0,0 +1,45 @@
+#pragma once
+#include "cholesky.hpp"
+#include <vector>
+#include <memory_resource>
+namespace portfolio_optimizer::optimization
+{
+    //Closed form of the fully invested minimum variance frontier. With x = cov^-1 * 1 and
+    //y = cov^-1 * expected_returns every frontier portfolio is a mix of x and y, so once both
+    //solves are done each target return costs O(N).
+    //Both solves live in resource, copies use the default resource again so they may outlive an arena.
+    class FrontierSolution
+    {
+    private:
+        std::pmr::vector<double> inverse_ones;
+        std::pmr::vector<double> inverse_returns;
+        double a = 0;
+        double b = 0;
+        double c = 0;
+        double d = 0;
+        void finish(const double *expected_returns);
+
+    public:
+        FrontierSolution();
+        FrontierSolution(const std::vector<double> &inverse_ones, const std::vector<double> &inverse_returns, const std::vector<double> &expected_returns);
+        FrontierSolution(const Cholesky<double> &factor, const std::vector<double> &expected_returns);
+        template <typename Allocator>
+        FrontierSolution(const Cholesky<double, Allocator> &factor, const double *expected_returns,
+                         std::pmr::memory_resource *resource = std::pmr::get_default_resource())
+            : inverse_ones(factor.size(), 1.0, resource), inverse_returns(expected_returns, expected_returns + factor.size(), resource)
+        {
+            factor.solve(inverse_ones.data());
+            factor.solve(inverse_returns.data());
+            finish(expected_returns);
+        }
+        size_t size() const;
+        void weights(const double target_return, double *result) const;
+        std::vector<double> weights(const double target_return) const;
+        void minimum_variance_weights(double *result) const;
+        std::vector<double> minimum_variance_weights() const;
+        double minimum_variance_return() const;
+        double variance(const double target_return) const;
+        //Multipliers of the return and budget constraints of min w'(2 cov)w, as the bordered KKT system reports them
+        std::vector<double> lagrange_multipliers(const double target_return) const;
+    };
+}
@@ -0,0 +1,201 @@
+#include "hierarchical_risk_parity.hpp"
+#include <cmath>
+#include <future>
+#include <thread>
+#include <limits>
+#include <numeric>
+#include <algorithm>
+#include <stdexcept>
+namespace portfolio_optimizer::optimization
+{
+    namespace
+    {
+        struct Edge
+        {
+            double distance;
+            size_t a;
+            size_t b;
+        };
+        size_t find_root(std::vector<size_t> &parent, size_t i)
+        {
+            while (parent[i] != i)
+            {
+                parent[i] = parent[parent[i]];
+                i = parent[i];
+            }
+            return i;
+        }
+        //Variance of the inverse variance portfolio of the assets order[begin, end)
+        double cluster_variance(const SymmetricMatrix<double> &covariance, const std::vector<size_t> &order, size_t begin, size_t end)
+        {
+            double total = 0;
+            for (size_t i = begin; i < end; i++)
+            {
+                total += 1 / covariance(order[i], order[i]);
+            }
+            double variance = 0;
+            for (size_t i = begin; i < end; i++)
+            {
+                double diagonal = covariance(order[i], order[i]);
+                double wi = 1 / (diagonal * total);
+                double sum = 0;
+                for (size_t j = begin; j < i; j++)
+                {
+                    sum += covariance(order[i], order[j]) / covariance(order[j], order[j]);
+                }
+                variance += wi * (2 * sum / total + wi * diagonal);
+            }
+            return variance;
+        }
+        //Splits order[begin, end) in halves and scales each half by the other half's share of the cluster variance
+        void bisect(const SymmetricMatrix<double> &covariance, const std::vector<size_t> &order, std::vector<double> &weights,
+                    size_t begin, size_t end, size_t parallel_depth)
+        {
+            if (end - begin < 2)
+            {
+                return;
+            }
+            size_t middle = begin + (end - begin) / 2;
+            double left_variance;
+            double right_variance;
+            if (parallel_depth > 0)
+            {
+                std::future<double> left = std::async(std::launch::async, cluster_variance, std::cref(covariance), std::cref(order), begin, middle);
+                right_variance = cluster_variance(covariance, order, middle, end);
+                left_variance = left.get();
+            }
+            else
+            {
+                left_variance = cluster_variance(covariance, order, begin, middle);
+                right_variance = cluster_variance(covariance, order, middle, end);
+            }
+            double alpha = 1 - left_variance / (left_variance + right_variance);
+            for (size_t i = begin; i < middle; i++)
+            {
+                weights[order[i]] *= alpha;
+            }
+            for (size_t i = middle; i < end; i++)
+            {
+                weights[order[i]] *= 1 - alpha;
+            }
+            if (parallel_depth > 0)
+            {
+                std::future<void> left = std::async(std::launch::async, bisect, std::cref(covariance), std::cref(order), std::ref(weights),
+                                                    begin, middle, parallel_depth - 1);
+                bisect(covariance, order, weights, middle, end, parallel_depth - 1);
+                left.get();
+            }
+            else
+            {
+                bisect(covariance, order, weights, begin, middle, 0);
+                bisect(covariance, order, weights, middle, end, 0);
+            }
+        }
+    }
+    HierarchicalRiskParityResult hierarchical_risk_parity(const SymmetricMatrix<double> &covariance, size_t threads)
+    {
+        const size_t n = covariance.rows;
+        HierarchicalRiskParityResult result;
+        if (n == 0)
+        {
+            return result;
+        }
+        std::vector<double> inverse_volatility(n);
+        for (size_t i = 0; i < n; i++)
+        {
+            double variance = covariance.row(i)[i];
+            if (!(variance > 0))
+            {
+                throw std::invalid_argument("Covariance diagonal must be positive.");
+            }
+            inverse_volatility[i] = 1 / std::sqrt(variance);
+        }
+        //SLINK builds the single linkage pointer representation one asset at a time from its distances to the assets
+        //before it, which are exactly its packed row. O(N^2) time, O(N) memory: asset i joins pointer[i] at height[i].
+        std::vector<size_t> pointer(n);
+        std::vector<double> height(n);
+        std::vector<double> distance(n);
+        for (size_t i = 0; i < n; i++)
+        {
+            pointer[i] = i;
+            height[i] = std::numeric_limits<double>::infinity();
+            const double *row = covariance.row(i);
+            //1 - rho orders pairs like the distance does, the square root is only taken for the n - 1 heights
+            for (size_t j = 0; j < i; j++)
+            {
+                distance[j] = std::max(0.0, 1 - row[j] * inverse_volatility[i] * inverse_volatility[j]);
+            }
+            //Either branch of the textbook update lowers distance[pointer[j]] to max(height[j], distance[j])
+            for (size_t j = 0; j < i; j++)
+            {
+                double joined = height[j];
+                double through = distance[j];
+                size_t target = pointer[j];
+                distance[target] = std::min(distance[target], std::max(joined, through));
+                height[j] = std::min(joined, through);
+                pointer[j] = joined >= through ? i : target;
+            }
+            for (size_t j = 0; j < i; j++)
+            {
+                pointer[j] = height[j] >= height[pointer[j]] ? i : pointer[j];
+            }
+        }
+        std::vector<Edge> edges;
+        edges.reserve(n - 1);
+        for (size_t i = 0; i + 1 < n; i++)
+        {
+            edges.push_back({std::sqrt(0.5 * height[i]), pointer[i], i});
+        }
+        //Single linkage merges the pointer edges from the shortest up
+        std::stable_sort(edges.begin(), edges.end(), [](const Edge &a, const Edge &b) { return a.distance < b.distance; });
+        std::vector<size_t> parent(n);
+        std::iota(parent.begin(), parent.end(), 0);
+        std::vector<size_t> cluster(n);
+        std::iota(cluster.begin(), cluster.end(), 0);
+        result.children.reserve(n - 1);
+        result.heights.reserve(n - 1);
+        for (const Edge &edge : edges)
+        {
+            size_t a = find_root(parent, edge.a);
+            size_t b = find_root(parent, edge.b);
+            //Smaller cluster id first, as scipy orders linkage rows
+            result.children.push_back({std::min(cluster[a], cluster[b]), std::max(cluster[a], cluster[b])});
+            result.heights.push_back(edge.distance);
+            parent[b] = a;
+            cluster[a] = n + result.children.size() - 1;
+        }
+        //Leaves in dendrogram order, left subtree first
+        result.order.reserve(n);
+        std::vector<size_t> stack(1, 2 * n - 2);
+        while (!stack.empty())
+        {
+            size_t node = stack.back();
+            stack.pop_back();
+            if (node < n)
+            {
+                result.order.push_back(node);
+            }
+            else
+            {
+                stack.push_back(result.children[node - n].second);
+                stack.push_back(result.children[node - n].first);
+            }
+        }
+        if (threads == 0)
+        {
+            threads = std::max<size_t>(1, std::thread::hardware_concurrency());
+        }
+        size_t parallel_depth = 0;
+        while ((size_t(1) << parallel_depth) < threads)
+        {
+            parallel_depth++;
+        }
+        result.weights.assign(n, 1.0);
+        bisect(covariance, result.order, result.weights, 0, n, parallel_depth);
+        return result;
+    }
+    HierarchicalRiskParityResult hierarchical_risk_parity(const Matrix<double> &covariance, size_t threads)
+    {
+        return hierarchical_risk_parity(SymmetricMatrix<double>(covariance), threads);
+    }
+}
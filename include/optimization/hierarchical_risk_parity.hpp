@@ -0,0 +1,22 @@
+#pragma once
+#include "matrix.hpp"
+#include "symmetric_matrix.hpp"
+#include <vector>
+namespace portfolio_optimizer::optimization
+{
+    typedef struct
+    {
+        std::vector<double> weights;
+        //Assets in quasi-diagonal order, neighbours in this order are close in the single linkage tree
+        std::vector<size_t> order;
+        //Single linkage merges, cluster N + k joins children[k].first and children[k].second at heights[k]
+        std::vector<std::pair<size_t, size_t>> children;
+        std::vector<double> heights;
+    } HierarchicalRiskParityResult;
+    //Hierarchical risk parity: correlation distance sqrt((1 - rho) / 2), single linkage clustering (SLINK over the
+    //packed rows), quasi-diagonalisation and recursive bisection with inverse variance cluster weights.
+    //Never inverts the covariance, so it stays usable when the matrix is singular. Distances are computed on the fly
+    //and the top levels of the bisection run in parallel, threads = 0 uses every hardware thread.
+    HierarchicalRiskParityResult hierarchical_risk_parity(const SymmetricMatrix<double> &covariance, size_t threads = 0);
+    HierarchicalRiskParityResult hierarchical_risk_parity(const Matrix<double> &covariance, size_t threads = 0);
+}
@@ -0,0 +1,119 @@
+#include "linear_algebra.hpp"
+#include "../kernels/kernels.hpp"
+#include <vector>
+#include <thread>
+#include <algorithm>
+namespace portfolio_optimizer::optimization
+{
+    namespace
+    {
+        //Threads split the rows of C in multiples of the gemm kernel's 4 row blocks
+        constexpr size_t micro_rows = 4;
+        //Rows of packed C per rank_k_update call in packed_rank_k_update
+        constexpr size_t packed_block = 32;
+        //Multiply-adds a thread of gemm or spmm must get to repay starting it
+        constexpr size_t parallel_work = size_t(1) << 20;
+        size_t worth_threads(size_t threads, const size_t work)
+        {
+            if (threads == 0)
+            {
+                threads = std::max<size_t>(1, std::thread::hardware_concurrency());
+            }
+            return std::max<size_t>(1, std::min(threads, work / parallel_work));
+        }
+    }
+    double dot(const double *x, const double *y, size_t n)
+    {
+        return kernels::active().dot(x, y, n);
+    }
+    void axpy(double alpha, const double *x, double *y, size_t n)
+    {
+        kernels::active().axpy(alpha, x, y, n);
+    }
+    void gemv(const double *a, const double *x, double *y, size_t rows, size_t cols)
+    {
+        const kernels::Kernels &kernel = kernels::active();
+        for (size_t i = 0; i < rows; i++)
+        {
+            y[i] = kernel.dot(a + i * cols, x, cols);
+        }
+    }
+    void gemm(const double *a, const double *b, double *c, size_t m, size_t k, size_t n, size_t threads)
+    {
+        const kernels::Kernels &kernel = kernels::active();
+        size_t blocks = (m + micro_rows - 1) / micro_rows;
+        threads = std::min(worth_threads(threads, m * k * n), blocks);
+        if (threads == 1)
+        {
+            kernel.gemm_rows(a, b, c, 0, m, k, n);
+            return;
+        }
+        std::vector<std::thread> workers(threads);
+        for (size_t t = 0; t < threads; t++)
+        {
+            size_t first = std::min(m, blocks * t / threads * micro_rows);
+            size_t last = std::min(m, blocks * (t + 1) / threads * micro_rows);
+            workers[t] = std::thread(kernel.gemm_rows, a, b, c, first, last, k, n);
+        }
+        for (size_t t = 0; t < threads; t++)
+        {
+            workers[t].join();
+        }
+    }
+    void rank_k_update(const double *a, const double *b, double *c, size_t m, size_t k, size_t n)
+    {
+        kernels::active().rank_k_update(a, b, c, m, k, n);
+    }
+    void packed_rank_k_update(const double *a, double *packed, size_t n, size_t k, size_t start)
+    {
+        std::vector<double> block(packed_block * n);
+        for (size_t first = start; first < n; first += packed_block)
+        {
+            size_t last = std::min(n, first + packed_block);
+            size_t rows = last - first;
+            //Block rows hold columns [0, last), the part of each above the diagonal is scratch
+            for (size_t i = first; i < last; i++)
+            {
+                const double *row = packed + i * (i + 1) / 2;
+                std::copy(row, row + i + 1, block.data() + (i - first) * last);
+            }
+            rank_k_update(a + first * k, a, block.data(), rows, k, last);
+            for (size_t i = first; i < last; i++)
+            {
+                const double *row = block.data() + (i - first) * last;
+                std::copy(row, row + i + 1, packed + i * (i + 1) / 2);
+            }
+        }
+    }
+    void packed_rank_one_update(double alpha, const double *x, double *packed, size_t n)
+    {
+        kernels::active().packed_rank_one_update(alpha, x, packed, n);
+    }
+    void packed_rank_two_update(const double *x, const double *y, double *packed, size_t n)
+    {
+        kernels::active().packed_rank_two_update(x, y, packed, n);
+    }
+    void spmv(const double *packed, const double *x, double *y, size_t n)
+    {
+        kernels::active().spmm_rows(x, packed, y, 0, 1, n);
+    }
+    void spmm(const double *x, const double *packed, double *y, size_t m, size_t n, size_t threads)
+    {
+        threads = std::min(worth_threads(threads, m * n * n), m);
+        const kernels::Kernels &kernel = kernels::active();
+        if (threads == 1)
+        {
+            kernel.spmm_rows(x, packed, y, 0, m, n);
+            return;
+        }
+        std::vector<std::thread> workers(threads);
+        for (size_t t = 0; t < threads; t++)
+        {
+            workers[t] = std::thread(kernel.spmm_rows, x, packed, y, m * t / threads, m * (t + 1) / threads, n);
+        }
+        for (size_t t = 0; t < threads; t++)
+        {
+            workers[t].join();
+        }
+    }
+}
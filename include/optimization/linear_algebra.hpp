@@ -0,0 +1,30 @@
+#pragma once
+#include <cstddef>
+namespace portfolio_optimizer::optimization
+{
+    //Kernels over raw row-major storage, shared by the Matrix based engines.
+    //Each call runs the variant for the best instruction set of this CPU, see kernels/kernels.hpp.
+    double dot(const double *x, const double *y, size_t n);
+    //y += alpha * x
+    void axpy(double alpha, const double *x, double *y, size_t n);
+    //y = A * x, A is rows x cols
+    void gemv(const double *a, const double *x, double *y, size_t rows, size_t cols);
+    //C = A * B, A is m x k and B is k x n. Rows of C are split across up to threads threads (0 uses every hardware thread),
+    //each getting at least about 2^20 multiply-adds, so small products run on the caller's thread
+    void gemm(const double *a, const double *b, double *c, size_t m, size_t k, size_t n, size_t threads = 1);
+    //C -= A * B^T, A is m x k, B is n x k and C is m x n. Rows of A and B are dotted in 2 x 2 blocks, so no transpose is needed
+    void rank_k_update(const double *a, const double *b, double *c, size_t m, size_t k, size_t n);
+    //Lower triangle of packed symmetric C (n x n) -= A * A^T, A is n x k. Rows of C are updated in blocks through rank_k_update,
+    //so only the diagonal blocks compute entries above the diagonal. Only rows [first, n) of C are touched, disjoint row ranges
+    //can be updated from different threads
+    void packed_rank_k_update(const double *a, double *packed, size_t n, size_t k, size_t first = 0);
+    //Packed symmetric A += alpha * x * x^T
+    void packed_rank_one_update(double alpha, const double *x, double *packed, size_t n);
+    //Packed symmetric A += x * x^T - y * y^T in one pass
+    void packed_rank_two_update(const double *x, const double *y, double *packed, size_t n);
+    //Packed symmetric A is n x n stored as its lower triangle row by row, see SymmetricMatrix. y = A * x
+    void spmv(const double *packed, const double *x, double *y, size_t n);
+    //Y = X * A for the m rows of X, A packed symmetric n x n. Each packed row is read once for every row of X, rows of Y are split
+    //across threads like gemm's rows of C
+    void spmm(const double *x, const double *packed, double *y, size_t m, size_t n, size_t threads = 1);
+}
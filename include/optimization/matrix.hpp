@@ -5,23 +5,58 @@
 #include <unordered_map>
 #include <iostream>
 #include <cmath>
+#include <memory>
+#include <utility>
+#include <type_traits>
+#include "linear_algebra.hpp"
 namespace portfolio_optimizer::optimization
 {
-    template <typename T, typename = typename std::enable_if<std::is_arithmetic<T>::value, T>::type>
+    //Allocator lets solver scratch live in an arena (see arena.hpp), results of operations use the allocator of the left operand
+    template <typename T, typename Allocator = std::allocator<T>, typename = typename std::enable_if<std::is_arithmetic<T>::value, T>::type>
     class Matrix
     {
     private:
-        std::vector<T> data;
+        std::vector<T, Allocator> data;
+        //c = a * b, a is m x k and b is k x n. Double products run the dispatched kernels of linear_algebra.hpp
+        static void multiply(const T *a, const T *b, T *c, const size_t m, const size_t k, const size_t n)
+        {
+            if constexpr (std::is_same_v<T, double>)
+            {
+                if (n == 1)
+                {
+                    gemv(a, b, c, m, k);
+                }
+                else
+                {
+                    gemm(a, b, c, m, k, n);
+                }
+            }
+            else
+            {
+                for (size_t i = 0; i < m; i++)
+                {
+                    for (size_t j = 0; j < n; j++)
+                    {
+                        T sum = 0;
+                        for (size_t p = 0; p < k; p++)
+                        {
+                            sum += a[i * k + p] * b[p * n + j];
+                        }
+                        c[i * n + j] = sum;
+                    }
+                }
+            }
+        }
     public:
         size_t rows;
         size_t cols;
-        Matrix(const size_t rows, const size_t cols)
+        Matrix(const size_t rows, const size_t cols, const Allocator &allocator = Allocator()) : data(allocator)
         {
             this->rows = rows;
             this->cols = cols;
             data.resize(rows * cols);
         }
-        Matrix(const std::vector<std::vector<T>> &data)
+        Matrix(const std::vector<std::vector<T>> &data, const Allocator &allocator = Allocator()) : data(allocator)
         {
             this->rows = data.size();
             this->cols = data[0].size();
@@ -39,19 +74,22 @@ namespace portfolio_optimizer::optimization
             this->rows = 0;
             this->cols = 0;
         }
-        Matrix(const std::vector<T> &data, const size_t rows, const size_t cols)
+        Matrix(const std::vector<T> &data, const size_t rows, const size_t cols, const Allocator &allocator = Allocator()) : data(data.begin(), data.end(), allocator)
         {
             this->rows = rows;
             this->cols = cols;
-            this->data = data;
         }
-        Matrix<T> operator+(const Matrix<T> &other)
+        Allocator get_allocator() const
+        {
+            return data.get_allocator();
+        }
+        Matrix operator+(const Matrix &other)
         {
             if (rows != other.rows || cols != other.cols)
             {
                 throw std::invalid_argument("Matrix dimensions must agree.");
             }
-            Matrix<T> result(rows, cols);
+            Matrix result(rows, cols, data.get_allocator());
             for (size_t i = 0; i < rows; i++)
             {
                 for (size_t j = 0; j < cols; j++)
@@ -61,13 +99,13 @@ namespace portfolio_optimizer::optimization
             }
             return result;
         }
-        Matrix<T> operator-(const Matrix<T> &other)
+        Matrix operator-(const Matrix &other)
         {
             if (rows != other.rows || cols != other.cols)
             {
                 throw std::invalid_argument("Matrix dimensions must agree.");
             }
-            Matrix<T> result(rows, cols);
+            Matrix result(rows, cols, data.get_allocator());
             for (size_t i = 0; i < rows; i++)
             {
                 for (size_t j = 0; j < cols; j++)
@@ -77,65 +115,35 @@ namespace portfolio_optimizer::optimization
             }
             return result;
         }
-        Matrix<T> operator*(const Matrix<T> &other)
+        Matrix operator*(const Matrix &other)
         {
             if (cols != other.rows)
             {
                 throw std::invalid_argument("Matrix dimensions must agree.");
             }
-            Matrix<T> result(rows, other.cols);
-            for (size_t i = 0; i < rows; i++)
-            {
-                for (size_t j = 0; j < other.cols; j++)
-                {
-                    T sum = 0;
-                    for (size_t k = 0; k < cols; k++)
-                    {
-                        sum += data[i * cols + k] * other.data[k * other.cols + j];
-                    }
-                    result(i, j) = sum;
-                }
-            }
+            Matrix result(rows, other.cols, data.get_allocator());
+            multiply(data.data(), other.data.data(), result.data.data(), rows, cols, other.cols);
             return result;
         }
-        Matrix<T> operator*(const std::vector<T> &other)
+        Matrix operator*(const std::vector<T> &other)
         {
             if (cols != other.size())
             {
                 throw std::invalid_argument("Matrix dimensions must agree.");
             }
-            Matrix<T> result(rows, 1);
-            for (size_t i = 0; i < rows; i++)
-            {
-                T sum = 0;
-                for (size_t k = 0; k < cols; k++)
-                {
-                    sum += data[i * cols + k] * other[k];
-                }
-                result(i, 0) = sum;
-            }
+            Matrix result(rows, 1, data.get_allocator());
+            multiply(data.data(), other.data(), result.data.data(), rows, cols, 1);
             return result;
         }
-        void operator*=(const Matrix<T> &other)
+        void operator*=(const Matrix &other)
         {
             if (cols != other.rows)
             {
                 throw std::invalid_argument("Matrix dimensions must agree.");
             }
-            Matrix<T> result(rows, other.cols);
-            for (size_t i = 0; i < rows; i++)
-            {
-                for (size_t j = 0; j < other.cols; j++)
-                {
-                    T sum = 0;
-                    for (size_t k = 0; k < cols; k++)
-                    {
-                        sum += data[i * cols + k] * other.data[k * other.cols + j];
-                    }
-                    result(i, j) = sum;
-                }
-            }
-            *this = result;
+            Matrix result(rows, other.cols, data.get_allocator());
+            multiply(data.data(), other.data.data(), result.data.data(), rows, cols, other.cols);
+            *this = std::move(result);
         }
         void operator*=(const std::vector<T> &other)
         {
@@ -143,21 +151,13 @@ namespace portfolio_optimizer::optimization
             {
                 throw std::invalid_argument("Matrix dimensions must agree.");
             }
-            Matrix<T> result(rows, 1);
-            for (size_t i = 0; i < rows; i++)
-            {
-                T sum = 0;
-                for (size_t k = 0; k < cols; k++)
-                {
-                    sum += data[i * cols + k] * other[k];
-                }
-                result(i, 0) = sum;
-            }
-            *this = result;
+            Matrix result(rows, 1, data.get_allocator());
+            multiply(data.data(), other.data(), result.data.data(), rows, cols, 1);
+            *this = std::move(result);
         }
-        Matrix<T> operator*(const T &scalar)
+        Matrix operator*(const T &scalar)
         {
-            Matrix<T> result(rows, cols);
+            Matrix result(rows, cols, data.get_allocator());
             for (size_t i = 0; i < rows; i++)
             {
                 for (size_t j = 0; j < cols; j++)
@@ -177,9 +177,9 @@ namespace portfolio_optimizer::optimization
                 }
             }
         }
-        Matrix<T> operator/(const T &scalar)
+        Matrix operator/(const T &scalar)
         {
-            Matrix<T> result(rows, cols);
+            Matrix result(rows, cols, data.get_allocator());
             for (size_t i = 0; i < rows; i++)
             {
                 for (size_t j = 0; j < cols; j++)
@@ -193,9 +193,9 @@ namespace portfolio_optimizer::optimization
         {
             return rows == cols;
         }
-        Matrix<T> transpose()
+        Matrix transpose()
         {
-            Matrix<T> result(cols, rows);
+            Matrix result(cols, rows, data.get_allocator());
             for (size_t i = 0; i < rows; i++)
             {
                 for (size_t j = 0; j < cols; j++)
@@ -213,8 +213,8 @@ namespace portfolio_optimizer::optimization
             {
                 throw std::invalid_argument("Matrix must be square.");
             }
-            Matrix<T> L(rows, cols);
-            Matrix<T> U(rows, cols);
+            Matrix L(rows, cols, data.get_allocator());
+            Matrix U(rows, cols, data.get_allocator());
             for (size_t i = 0; i < rows; i++)
             {
                 for (size_t k = i; k < cols; k++)
@@ -254,18 +254,18 @@ namespace portfolio_optimizer::optimization
             }
             return det;
         }
-        Matrix<T> cofactor()
+        Matrix cofactor()
         {
             if (!is_square())
             {
                 throw std::invalid_argument("Matrix must be square.");
             }
-            Matrix<T> result(rows, cols);
+            Matrix result(rows, cols, data.get_allocator());
             for (size_t i = 0; i < rows; i++)
             {
                 for (size_t j = 0; j < cols; j++)
                 {
-                    Matrix<T> submatrix(rows - 1, cols - 1);
+                    Matrix submatrix(rows - 1, cols - 1, data.get_allocator());
                     for (size_t k = 0; k < rows; k++)
                     {
                         for (int l = 0; l < cols; l++)
@@ -281,7 +281,7 @@ namespace portfolio_optimizer::optimization
             }
             return result;
         }
-        Matrix<T> inverse()
+        Matrix inverse()
         {
             if (!is_square())
             {
@@ -317,8 +317,21 @@ namespace portfolio_optimizer::optimization
         {
             return data[row * cols + col];
         }
+        const T& operator()(const size_t row,const size_t col) const
+        {
+            return data[row * cols + col];
+        }
+        //Row-major storage, row i starts at values() + i * cols
+        T* values()
+        {
+            return data.data();
+        }
+        const T* values() const
+        {
+            return data.data();
+        }
         void cbind(const T& value){
-            Matrix<T> result(rows, cols + 1);
+            Matrix result(rows, cols + 1, data.get_allocator());
             for (size_t i = 0; i < rows; i++)
             {
                 for (size_t j = 0; j < cols; j++)
@@ -327,13 +340,13 @@ namespace portfolio_optimizer::optimization
                 }
                 result(i, cols) = value;
             }
-            *this = result;
+            *this = std::move(result);
         }
         void cbind(const std::vector<T>& values){
             if(values.size() != rows){
                 throw std::invalid_argument("Vector size must be equal to number of rows.");
             }
-            Matrix<T> result(rows, cols + 1);
+            Matrix result(rows, cols + 1, data.get_allocator());
             for (size_t i = 0; i < rows; i++)
             {
                 for (size_t j = 0; j < cols; j++)
@@ -342,10 +355,10 @@ namespace portfolio_optimizer::optimization
                 }
                 result(i, cols) = values[i];
             }
-            *this = result;
+            *this = std::move(result);
         }
         void rbind(const T& value){
-            Matrix<T> result(rows + 1, cols);
+            Matrix result(rows + 1, cols, data.get_allocator());
             for (size_t i = 0; i < rows; i++)
             {
                 for (size_t j = 0; j < cols; j++)
@@ -357,13 +370,13 @@ namespace portfolio_optimizer::optimization
             {
                 result(rows, j) = value;
             }
-            *this = result;
+            *this = std::move(result);
         }
         void rbind(const std::vector<T>& values){
             if(values.size() != cols){
                 throw std::invalid_argument("Vector size must be equal to number of columns.");
             }
-            Matrix<T> result(rows + 1, cols);
+            Matrix result(rows + 1, cols, data.get_allocator());
             for (size_t i = 0; i < rows; i++)
             {
                 for (size_t j = 0; j < cols; j++)
@@ -375,15 +388,15 @@ namespace portfolio_optimizer::optimization
             {
                 result(rows, j) = values[j];
             }
-            *this = result;
+            *this = std::move(result);
         }
-        Matrix<T> submatrix(size_t row, size_t col)
+        Matrix submatrix(size_t row, size_t col)
         {
             if (row >= rows || col >= cols)
             {
                 throw std::invalid_argument("Row or column index out of bounds.");
             }
-            Matrix<T> result(rows - 1, cols - 1);
+            Matrix result(rows - 1, cols - 1, data.get_allocator());
             for (size_t i = 0; i < rows; i++)
             {
                 for (size_t j = 0; j < cols; j++)
@@ -396,7 +409,7 @@ namespace portfolio_optimizer::optimization
             }
             return result;
         }
-        Matrix<T> submatrix(size_t row, size_t col, size_t row_count, size_t col_count)
+        Matrix submatrix(size_t row, size_t col, size_t row_count, size_t col_count)
         {
             if (row >= rows || col >= cols)
             {
@@ -406,7 +419,7 @@ namespace portfolio_optimizer::optimization
             {
                 throw std::invalid_argument("Submatrix out of bounds.");
             }
-            Matrix<T> result(row_count, col_count);
+            Matrix result(row_count, col_count, data.get_allocator());
             for (size_t i = 0; i < row_count; i++)
             {
                 for (size_t j = 0; j < col_count; j++)
@@ -1,12 +1,17 @@
 #include "optimization.hpp"
 #include <cmath>
-#include <thread>
+#include <algorithm>
 namespace portfolio_optimizer::optimization
 {
+    namespace
+    {
+        //Name of the risk-free column appended after the tickers
+        const std::string risk_free_ticker = "rf";
+    }
     double calculate_mean(const std::vector<double> &x)
     {
         double sum = 0;
-        for (int i = 0; i < x.size(); i++)
+        for (size_t i = 0; i < x.size(); i++)
         {
             sum += x[i];
         }
@@ -17,20 +22,27 @@ namespace portfolio_optimizer::optimization
         double mean_x = calculate_mean(x);
         double mean_y = calculate_mean(y);
         double covariance = 0;
-        for (int i = 0; i < x.size(); i++)
+        for (size_t i = 0; i < x.size(); i++)
         {
             covariance += (x[i] - mean_x) * (y[i] - mean_y);
         }
         return covariance / (x.size() - 1);
     }
-    Matrix<double> calculate_covariance_matrix(const std::unordered_map<std::string, std::vector<double>> &historical_prices)
+    SymmetricMatrix<double> calculate_covariance_matrix(const std::unordered_map<std::string, std::vector<double>> &historical_prices)
     {
-        Matrix<double> covariance_matrix(historical_prices.size(), historical_prices.size());
-        for (int i = 0; i < historical_prices.size(); i++)
+        //Columns in the map's iteration order, gathered once instead of walking the map for every entry
+        std::vector<const std::vector<double> *> columns;
+        columns.reserve(historical_prices.size());
+        for (const auto &[ticker, prices] : historical_prices)
+        {
+            columns.push_back(&prices);
+        }
+        SymmetricMatrix<double> covariance_matrix(columns.size());
+        for (size_t i = 0; i < columns.size(); i++)
         {
-            for (int j = 0; j < historical_prices.size(); j++)
+            for (size_t j = 0; j <= i; j++)
             {
-                covariance_matrix(i, j) = calculate_covariance(historical_prices.at(std::next(historical_prices.begin(), i)->first), historical_prices.at(std::next(historical_prices.begin(), j)->first));
+                covariance_matrix(i, j) = calculate_covariance(*columns[i], *columns[j]);
             }
         }
         return covariance_matrix;
@@ -46,6 +58,15 @@ namespace portfolio_optimizer::optimization
     }
     Optimization::Optimization(const std::vector<std::string> &tickers, const std::unordered_map<std::string, std::vector<double>> &historical_prices, const std::vector<double> &expected_returns,
                                const double risk_free_rate,const Matrix<double>& covariance_matrix)
+    {
+        this->tickers = tickers;
+        this->historical_prices = historical_prices;
+        this->expected_returns = expected_returns;
+        this->risk_free_rate = risk_free_rate;
+        this->covariance_matrix = SymmetricMatrix<double>(covariance_matrix);
+    }
+    Optimization::Optimization(const std::vector<std::string> &tickers, const std::unordered_map<std::string, std::vector<double>> &historical_prices, const std::vector<double> &expected_returns,
+                               const double risk_free_rate, const SymmetricMatrix<double> &covariance_matrix)
     {
         this->tickers = tickers;
         this->historical_prices = historical_prices;
@@ -53,80 +74,107 @@ namespace portfolio_optimizer::optimization
         this->risk_free_rate = risk_free_rate;
         this->covariance_matrix = covariance_matrix;
     }
-    std::vector<OptimizationResult> Optimization::minimum_risk(const std::vector<double> &wanted_returns, bool use_risk_free_rate)
+    std::vector<OptimizationResult> Optimization::minimum_risk(const std::vector<double> &wanted_returns, bool use_risk_free_rate, size_t threads)
     {
-        Matrix<double> cov = covariance_matrix;
-        std::vector<std::string> tickers = this->tickers;
-        std::vector<double> expected_returns = this->expected_returns;
+        //Every frontier point mixes cov^-1 * 1 and cov^-1 * expected_returns, so one factorization serves them all.
+        //Scratch comes from this thread's arena, which keeps its memory between calls; the scope only rewinds this call's part.
+        Arena &arena = Arena::thread_local_arena();
+        ArenaScope scope(arena);
+        ArenaAllocator<double> allocator(&arena);
+        const size_t assets = this->expected_returns.size() + use_risk_free_rate;
+        ArenaVector<double> expected_returns(this->expected_returns.begin(), this->expected_returns.end(), allocator);
+        //Packed rows do not depend on the size, so the covariance is a prefix of the augmented one
+        ArenaSymmetricMatrix<double> cov(assets, allocator);
+        std::copy(covariance_matrix.values(), covariance_matrix.values() + SymmetricMatrix<double>::packed_size(covariance_matrix.rows), cov.values());
         if (use_risk_free_rate)
         {
-            cov.cbind(0);
-            cov.rbind(0);
-            cov(cov.rows - 1, cov.cols - 1) = 1e-8;
-            tickers.push_back("rf");
+            cov(assets - 1, assets - 1) = 1e-8;
             expected_returns.push_back(risk_free_rate);
         }
-        cov *= 2;
-        cov.rbind(expected_returns);
-        cov.rbind(1);
-        std::vector<double> constraints(expected_returns.size() + 2);
-        for (size_t i = 0; i < expected_returns.size()+use_risk_free_rate; i++)
+        Cholesky<double, ArenaAllocator<double>> factor(cov, allocator);
+        FrontierSolution frontier(factor, expected_returns.data(), &arena);
+        std::vector<OptimizationResult> results(wanted_returns.size());
+        ArenaMatrix<double> weights(wanted_returns.size(), assets, allocator);
+        for (size_t i = 0; i < wanted_returns.size(); i++)
         {
-            if (i < expected_returns.size())
-            {
-                constraints[i] = expected_returns[i];
-            }
-            else
+            minimize_risk(results[i], weights.values() + i * assets, wanted_returns[i], frontier, tickers);
+        }
+        BasicRiskReport<ArenaAllocator<double>> report = decompose_risk(cov, weights, threads, allocator);
+        for (size_t i = 0; i < results.size(); i++)
+        {
+            results[i].volatility = report.volatility[i];
+            results[i].sharpe_ratio = (results[i].expected_return - risk_free_rate) / results[i].volatility;
+            results[i].covariance_contributions = std::unordered_map<std::string, double>();
+            results[i].covariance_contributions.reserve(assets);
+            for (size_t j = 0; j < assets; j++)
             {
-                constraints[i] = this->risk_free_rate;
+                results[i].covariance_contributions[j < tickers.size() ? tickers[j] : risk_free_ticker] = report.component(i, j);
             }
         }
-        constraints[expected_returns.size()+use_risk_free_rate] = 0;
-        constraints[expected_returns.size() + 1+use_risk_free_rate] = 0;
-        cov.cbind(constraints);
-        constraints.clear();
-        constraints.resize(cov.rows);
-        for (size_t i = 0; i < cov.rows; i++)
+        return results;
+    }
+    std::vector<OptimizationResult> Optimization::risk_parity(const std::vector<std::vector<double>> &budgets, const std::vector<std::vector<double>> &previous_weights, const RiskParityOptions &options, size_t threads)
+    {
+        std::vector<std::vector<double>> filled = budgets;
+        for (size_t i = 0; i < filled.size(); i++)
         {
-            constraints[i] = 1;
+            if (filled[i].empty())
+            {
+                filled[i].assign(tickers.size(), 1.0);
+            }
         }
-        constraints[cov.rows - 1] = 0;
-        constraints[cov.rows - 2] = 0;
-        cov.cbind(constraints);
-        constraints.clear();
-        std::vector<OptimizationResult> results(wanted_returns.size());
-        std::vector<std::thread> threads(wanted_returns.size());
-        for(size_t i = 0; i < wanted_returns.size(); i++)
+        std::vector<RiskParityResult> solutions = risk_budgeting(covariance_matrix, filled, options, previous_weights, threads);
+        Matrix<double> weights(solutions.size(), tickers.size());
+        for (size_t i = 0; i < solutions.size(); i++)
         {
-            threads[i] = std::thread(&Optimization::minimize_risk,this, std::ref(results[i]), wanted_returns[i], std::ref(expected_returns), std::ref(cov), std::ref(tickers));
+            std::copy(solutions[i].weights.begin(), solutions[i].weights.end(), weights.values() + i * weights.cols);
         }
-        for(size_t i = 0; i < wanted_returns.size(); i++)
+        RiskReport report = decompose_risk(covariance_matrix, weights, threads);
+        std::vector<OptimizationResult> results(solutions.size());
+        for (size_t i = 0; i < results.size(); i++)
         {
-            threads[i].join();
+            results[i].expected_return = 0;
+            results[i].leverage = 1;
+            for (size_t j = 0; j < tickers.size(); j++)
+            {
+                results[i].weights[tickers[j]] = solutions[i].weights[j];
+                results[i].covariance_contributions[tickers[j]] = report.component(i, j);
+                results[i].expected_return += solutions[i].weights[j] * expected_returns[j];
+            }
+            results[i].volatility = report.volatility[i];
+            results[i].sharpe_ratio = (results[i].expected_return - risk_free_rate) / results[i].volatility;
         }
         return results;
     }
-    void Optimization::minimize_risk(OptimizationResult &result, const double wanted_return, const std::vector<double> &expected_returns, Matrix<double> &covariance, const std::vector<std::string> &tickers)
+    OptimizationResult Optimization::hierarchical_risk_parity(size_t threads)
     {
-        std::vector<double> constraints(covariance.rows);
-        for (size_t i = 0; i < expected_returns.size(); i++)
+        HierarchicalRiskParityResult allocation = optimization::hierarchical_risk_parity(covariance_matrix, threads);
+        RiskDecomposition decomposition = decompose_risk(covariance_matrix, allocation.weights);
+        OptimizationResult result;
+        result.expected_return = 0;
+        result.leverage = 1;
+        for (size_t j = 0; j < tickers.size(); j++)
         {
-            constraints[i] = 0;
+            result.weights[tickers[j]] = allocation.weights[j];
+            result.covariance_contributions[tickers[j]] = decomposition.component[j];
+            result.expected_return += allocation.weights[j] * expected_returns[j];
         }
-        constraints[expected_returns.size()] = wanted_return;
-        constraints[expected_returns.size() + 1] = 1;
-        Matrix<double> solution = covariance.inverse() * constraints;
+        result.volatility = decomposition.volatility;
+        result.sharpe_ratio = (result.expected_return - risk_free_rate) / result.volatility;
+        return result;
+    }
+    void Optimization::minimize_risk(OptimizationResult &result, double *weights, const double wanted_return, const FrontierSolution &frontier, const std::vector<std::string> &tickers)
+    {
+        frontier.weights(wanted_return, weights);
         result.weights = std::unordered_map<std::string, double>();
-        Matrix<double> weights = solution.submatrix(0, 0, solution.rows - 2, 1);
+        result.weights.reserve(frontier.size());
         result.leverage = 0;
-        for (size_t i = 0; i < expected_returns.size(); i++)
+        for (size_t i = 0; i < frontier.size(); i++)
         {
-            result.weights[tickers[i]] = weights(i, 0);
-            result.leverage += abs(weights(i, 0));
+            result.weights[i < tickers.size() ? tickers[i] : risk_free_ticker] = weights[i];
+            result.leverage += std::abs(weights[i]);
         }
         result.expected_return = wanted_return;
-        result.volatility = std::sqrt((weights.transpose() * covariance.submatrix(0, 0, weights.rows, weights.rows) * weights)(0, 0));
-        result.lagrange_multipliers = solution.submatrix(solution.rows - 2, 0, 2, 1).as_vector();
-        result.sharpe_ratio = (wanted_return - risk_free_rate) / result.volatility;
+        result.lagrange_multipliers = frontier.lagrange_multipliers(wanted_return);
     }
 }
\ No newline at end of file
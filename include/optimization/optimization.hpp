@@ -1,5 +1,11 @@
 #pragma once
 #include "matrix.hpp"
+#include "symmetric_matrix.hpp"
+#include "arena.hpp"
+#include "frontier.hpp"
+#include "risk.hpp"
+#include "risk_parity.hpp"
+#include "hierarchical_risk_parity.hpp"
 #include <unordered_map>
 #include <vector>
 #include <string>
@@ -17,19 +23,27 @@ namespace portfolio_optimizer::optimization
     class Optimization
     {
     private:
-        Matrix<double> covariance_matrix;
+        SymmetricMatrix<double> covariance_matrix;
         std::vector<double> expected_returns;
         double risk_free_rate = 0;
         std::vector<std::string> tickers;
         std::unordered_map<std::string, std::vector<double>> historical_prices;
         double calculate_covariance(const std::vector<double> &x, const std::vector<double> &y);
         double calculate_mean(const std::vector<double> &x);
-        void minimize_risk(OptimizationResult& result,const double wanted_return,const std::vector<double>& expected_returns, Matrix<double>& covariance,const std::vector<std::string>& tickers);
+        void minimize_risk(OptimizationResult& result, double* weights, const double wanted_return, const FrontierSolution& frontier, const std::vector<std::string>& tickers);
     public:
         Optimization(const std::vector<std::string> &tickers, const std::unordered_map<std::string, std::vector<double>> &historical_prices, const std::vector<double> &expected_returns, const double risk_free_rate);
         Optimization(const std::vector<std::string> &tickers, const std::unordered_map<std::string, std::vector<double>> &historical_prices, const std::vector<double> &expected_returns, const double risk_free_rate,const Matrix<double>& covariance_matrix);
-        std::vector<OptimizationResult> minimum_risk(const std::vector<double>& expected_returns, bool use_risk_free_rate = false);
+        Optimization(const std::vector<std::string> &tickers, const std::unordered_map<std::string, std::vector<double>> &historical_prices, const std::vector<double> &expected_returns, const double risk_free_rate, const SymmetricMatrix<double>& covariance_matrix);
+        //threads bounds the threads of the risk decomposition, 0 uses every hardware thread
+        std::vector<OptimizationResult> minimum_risk(const std::vector<double>& expected_returns, bool use_risk_free_rate = false, size_t threads = 1);
+        //One fully invested long-only portfolio per risk budget (one positive entry per ticker), an empty budget means equal risk contribution.
+        //previous_weights warm-starts the matching budget, e.g. with yesterday's portfolio. threads bounds the threads solving the
+        //budgets and decomposing their risk, 0 uses every hardware thread.
+        std::vector<OptimizationResult> risk_parity(const std::vector<std::vector<double>>& budgets, const std::vector<std::vector<double>>& previous_weights = std::vector<std::vector<double>>(), const RiskParityOptions& options = RiskParityOptions(), size_t threads = 1);
+        //Fully invested long-only allocation that never inverts the covariance, usable when there are about as many tickers as observations
+        OptimizationResult hierarchical_risk_parity(size_t threads = 0);
     };
-    Matrix<double> calculate_covariance_matrix(const std::unordered_map<std::string, std::vector<double>> &historical_prices);
+    SymmetricMatrix<double> calculate_covariance_matrix(const std::unordered_map<std::string, std::vector<double>> &historical_prices);
     double calculate_covariance(const std::vector<double> &x, const std::vector<double> &y);
 }
\ No newline at end of file
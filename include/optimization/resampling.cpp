@@ -0,0 +1,341 @@
+#include "resampling.hpp"
+#include "symmetric_matrix.hpp"
+#include "cholesky.hpp"
+#include "frontier.hpp"
+#include "arena.hpp"
+#include "risk.hpp"
+#include "linear_algebra.hpp"
+#include <cmath>
+#include <atomic>
+#include <thread>
+#include <cstdint>
+#include <algorithm>
+#include <stdexcept>
+#include <exception>
+namespace portfolio_optimizer::optimization
+{
+    namespace
+    {
+        //Centred periods per packed_rank_k_update call, an assets x sample_block block stays in L2 for a few hundred assets
+        constexpr size_t sample_block = 256;
+        //Resamples are summed in fixed chunks that are merged in order, so the averages do not depend on the schedule
+        constexpr size_t chunk_size = 64;
+        constexpr size_t max_chunks = 256;
+        //Reused by every resample a worker handles, so steady state allocates nothing but the frontier's arena scratch
+        struct Workspace
+        {
+            std::vector<size_t> counts;
+            //Product L * A of a parametric draw, assets x assets
+            std::vector<double> draws;
+            std::vector<double> normals;
+            std::vector<const double *> rows;
+            std::vector<double> multiplicities;
+            std::vector<double> block;
+            std::vector<double> mean;
+            SymmetricMatrix<double> covariance;
+            Cholesky<double> factor;
+            std::vector<double> weights;
+        };
+        //Mean and covariance of workspace.rows, row u counted multiplicities[u] times out of observations
+        void estimate(Workspace &workspace, size_t assets, size_t observations)
+        {
+            const size_t count = workspace.rows.size();
+            workspace.mean.assign(assets, 0.0);
+            for (size_t u = 0; u < count; u++)
+            {
+                axpy(workspace.multiplicities[u], workspace.rows[u], workspace.mean.data(), assets);
+            }
+            for (size_t i = 0; i < assets; i++)
+            {
+                workspace.mean[i] /= observations;
+            }
+            if (workspace.covariance.rows != assets)
+            {
+                workspace.covariance = SymmetricMatrix<double>(assets);
+            }
+            double *covariance = workspace.covariance.values();
+            const size_t packed = SymmetricMatrix<double>::packed_size(assets);
+            std::fill(covariance, covariance + packed, 0.0);
+            workspace.block.resize(assets * sample_block);
+            //A repeated period enters once, scaled by the root of its multiplicity
+            for (size_t first = 0; first < count; first += sample_block)
+            {
+                const size_t k = std::min(sample_block, count - first);
+                double *block = workspace.block.data();
+                for (size_t u = 0; u < k; u++)
+                {
+                    const double *row = workspace.rows[first + u];
+                    const double scale = std::sqrt(workspace.multiplicities[first + u]);
+                    for (size_t i = 0; i < assets; i++)
+                    {
+                        block[i * k + u] = scale * (row[i] - workspace.mean[i]);
+                    }
+                }
+                packed_rank_k_update(block, covariance, assets, k);
+            }
+            const double scale = -1.0 / (observations - 1);
+            for (size_t i = 0; i < packed; i++)
+            {
+                covariance[i] *= scale;
+            }
+        }
+        void draw_bootstrap(Workspace &workspace, const Matrix<double> &returns, size_t observations, std::mt19937_64 &random)
+        {
+            const size_t periods = returns.rows;
+            workspace.counts.assign(periods, 0);
+            std::uniform_int_distribution<size_t> period(0, periods - 1);
+            for (size_t o = 0; o < observations; o++)
+            {
+                workspace.counts[period(random)]++;
+            }
+            workspace.rows.clear();
+            workspace.multiplicities.clear();
+            for (size_t t = 0; t < periods; t++)
+            {
+                if (workspace.counts[t] > 0)
+                {
+                    workspace.rows.push_back(returns.values() + t * returns.cols);
+                    workspace.multiplicities.push_back(static_cast<double>(workspace.counts[t]));
+                }
+            }
+        }
+        //Draws the moments of observations normal periods directly instead of the periods themselves: the mean is
+        //mean + L * z / sqrt(observations) and (observations - 1) times the covariance is Wishart, L * A * A^T * L^T with
+        //A lower triangular (Bartlett). O(N^2) draws and O(N^3) work instead of O(T * N^2). factor is the history's covariance factor.
+        void draw_parametric(Workspace &workspace, const std::vector<double> &mean, const Cholesky<double> &factor, size_t observations, std::mt19937_64 &random)
+        {
+            const size_t assets = mean.size();
+            std::normal_distribution<double> normal;
+            workspace.normals.resize(assets);
+            for (size_t i = 0; i < assets; i++)
+            {
+                workspace.normals[i] = normal(random);
+            }
+            workspace.mean.resize(assets);
+            const double root = std::sqrt(static_cast<double>(observations));
+            for (size_t i = 0; i < assets; i++)
+            {
+                workspace.mean[i] = mean[i] + dot(factor.values() + SymmetricMatrix<double>::offset(i), workspace.normals.data(), i + 1) / root;
+            }
+            //Bartlett factor A in the first assets x assets of block, then L * A row by row in draws
+            workspace.block.assign(assets * assets, 0.0);
+            double *bartlett = workspace.block.data();
+            for (size_t i = 0; i < assets; i++)
+            {
+                for (size_t j = 0; j < i; j++)
+                {
+                    bartlett[i * assets + j] = normal(random);
+                }
+                std::chi_squared_distribution<double> chi_squared(static_cast<double>(observations - 1 - i));
+                bartlett[i * assets + i] = std::sqrt(chi_squared(random));
+            }
+            workspace.draws.assign(assets * assets, 0.0);
+            double *product = workspace.draws.data();
+            for (size_t i = 0; i < assets; i++)
+            {
+                const double *row = factor.values() + SymmetricMatrix<double>::offset(i);
+                for (size_t k = 0; k <= i; k++)
+                {
+                    axpy(row[k], bartlett + k * assets, product + i * assets, k + 1);
+                }
+            }
+            if (workspace.covariance.rows != assets)
+            {
+                workspace.covariance = SymmetricMatrix<double>(assets);
+            }
+            double *covariance = workspace.covariance.values();
+            const size_t packed = SymmetricMatrix<double>::packed_size(assets);
+            std::fill(covariance, covariance + packed, 0.0);
+            packed_rank_k_update(product, covariance, assets, assets);
+            const double scale = -1.0 / (observations - 1);
+            for (size_t i = 0; i < packed; i++)
+            {
+                covariance[i] *= scale;
+            }
+        }
+    }
+    FrontierResampler::FrontierResampler(const std::vector<std::string> &tickers, const std::unordered_map<std::string, std::vector<double>> &historical_returns)
+    {
+        if (tickers.empty())
+        {
+            throw std::invalid_argument("At least one ticker is needed.");
+        }
+        size_t periods = historical_returns.at(tickers[0]).size();
+        this->tickers = tickers;
+        this->returns = Matrix<double>(periods, tickers.size());
+        for (size_t j = 0; j < tickers.size(); j++)
+        {
+            const std::vector<double> &series = historical_returns.at(tickers[j]);
+            if (series.size() != periods)
+            {
+                throw std::invalid_argument("Every ticker must have the same number of returns.");
+            }
+            for (size_t i = 0; i < periods; i++)
+            {
+                returns(i, j) = series[i];
+            }
+        }
+    }
+    FrontierResampler::FrontierResampler(const std::vector<std::string> &tickers, const Matrix<double> &returns)
+    {
+        if (returns.cols != tickers.size())
+        {
+            throw std::invalid_argument("Matrix dimensions must agree.");
+        }
+        this->tickers = tickers;
+        this->returns = returns;
+    }
+    const std::vector<std::string> &FrontierResampler::get_tickers() const
+    {
+        return tickers;
+    }
+    ResampledFrontier FrontierResampler::run(const std::vector<double> &target_returns, const ResamplingConfig &config) const
+    {
+        const size_t periods = returns.rows;
+        const size_t assets = returns.cols;
+        const size_t targets = target_returns.size();
+        const size_t observations = config.observations == 0 ? periods : config.observations;
+        if (periods < 2 || observations < 2)
+        {
+            throw std::invalid_argument("At least two observations are needed.");
+        }
+        if (config.resamples == 0)
+        {
+            throw std::invalid_argument("At least one resample is needed.");
+        }
+        //Moments of the full history, the parametric resamples draw from them
+        Workspace population;
+        population.multiplicities.assign(periods, 1.0);
+        for (size_t t = 0; t < periods; t++)
+        {
+            population.rows.push_back(returns.values() + t * assets);
+        }
+        estimate(population, assets, periods);
+        if (config.method == ResamplingMethod::parametric)
+        {
+            if (observations <= assets)
+            {
+                throw std::invalid_argument("Parametric resampling needs more observations than assets.");
+            }
+            population.factor.factor(population.covariance);
+        }
+        const size_t chunk = std::max(chunk_size, (config.resamples + max_chunks - 1) / max_chunks);
+        const size_t chunks = (config.resamples + chunk - 1) / chunk;
+        std::vector<Matrix<double>> sums(chunks, Matrix<double>(targets, assets));
+        std::vector<Matrix<double>> squares(chunks, Matrix<double>(targets, assets));
+        std::vector<size_t> rejected(chunks, 0);
+        std::vector<std::exception_ptr> errors(chunks);
+        size_t threads = config.threads;
+        if (threads == 0)
+        {
+            threads = std::max<size_t>(1, std::thread::hardware_concurrency());
+        }
+        threads = std::max<size_t>(1, std::min(threads, chunks));
+        std::atomic<size_t> next = 0;
+        std::vector<std::thread> workers(threads);
+        for (size_t t = 0; t < threads; t++)
+        {
+            workers[t] = std::thread([&]()
+            {
+                Workspace workspace;
+                workspace.weights.resize(targets * assets);
+                Arena &arena = Arena::thread_local_arena();
+                for (size_t c = next++; c < chunks; c = next++)
+                {
+                    try
+                    {
+                        double *sum = sums[c].values();
+                        double *square = squares[c].values();
+                        for (size_t r = c * chunk; r < std::min(config.resamples, (c + 1) * chunk); r++)
+                        {
+                            std::seed_seq sequence{config.seed, static_cast<unsigned int>(r), static_cast<unsigned int>(static_cast<uint64_t>(r) >> 32)};
+                            std::mt19937_64 random(sequence);
+                            if (config.method == ResamplingMethod::bootstrap)
+                            {
+                                draw_bootstrap(workspace, returns, observations, random);
+                                estimate(workspace, assets, observations);
+                            }
+                            else
+                            {
+                                draw_parametric(workspace, population.mean, population.factor, observations, random);
+                            }
+                            try
+                            {
+                                ArenaScope scope(arena);
+                                //Already on a worker thread
+                                workspace.factor.factor(workspace.covariance, 1);
+                                FrontierSolution frontier(workspace.factor, workspace.mean.data(), &arena);
+                                for (size_t k = 0; k < targets; k++)
+                                {
+                                    frontier.weights(target_returns[k], workspace.weights.data() + k * assets);
+                                }
+                            }
+                            catch (const std::invalid_argument &)
+                            {
+                                //Too few distinct periods for the number of assets, or no spread in the expected returns
+                                rejected[c]++;
+                                continue;
+                            }
+                            for (size_t i = 0; i < targets * assets; i++)
+                            {
+                                sum[i] += workspace.weights[i];
+                                square[i] += workspace.weights[i] * workspace.weights[i];
+                            }
+                        }
+                    }
+                    catch (...)
+                    {
+                        errors[c] = std::current_exception();
+                    }
+                }
+            });
+        }
+        for (size_t t = 0; t < threads; t++)
+        {
+            workers[t].join();
+        }
+        for (size_t c = 0; c < chunks; c++)
+        {
+            if (errors[c])
+            {
+                std::rethrow_exception(errors[c]);
+            }
+        }
+        ResampledFrontier result;
+        result.target_returns = target_returns;
+        result.weights = Matrix<double>(targets, assets);
+        result.weight_deviation = Matrix<double>(targets, assets);
+        double *weights = result.weights.values();
+        double *deviation = result.weight_deviation.values();
+        for (size_t c = 0; c < chunks; c++)
+        {
+            const double *sum = sums[c].values();
+            const double *square = squares[c].values();
+            for (size_t i = 0; i < targets * assets; i++)
+            {
+                weights[i] += sum[i];
+                deviation[i] += square[i];
+            }
+            result.rejected += rejected[c];
+        }
+        result.resamples = config.resamples - result.rejected;
+        if (result.resamples == 0)
+        {
+            throw std::invalid_argument("Every resampled covariance was singular.");
+        }
+        const double accepted = static_cast<double>(result.resamples);
+        for (size_t i = 0; i < targets * assets; i++)
+        {
+            weights[i] /= accepted;
+            double variance = accepted > 1 ? (deviation[i] - accepted * weights[i] * weights[i]) / (accepted - 1) : 0;
+            deviation[i] = std::sqrt(std::max(0.0, variance));
+        }
+        result.expected_return.resize(targets);
+        for (size_t k = 0; k < targets; k++)
+        {
+            result.expected_return[k] = dot(weights + k * assets, population.mean.data(), assets);
+        }
+        result.volatility = decompose_risk(population.covariance, result.weights).volatility;
+        return result;
+    }
+}
@@ -0,0 +1,57 @@
+#pragma once
+#include "matrix.hpp"
+#include <random>
+#include <vector>
+#include <string>
+#include <unordered_map>
+namespace portfolio_optimizer::optimization
+{
+    enum class ResamplingMethod
+    {
+        //Periods drawn from the history with replacement
+        bootstrap,
+        //Mean and covariance of normal periods with the history's moments, drawn directly from their sampling distributions
+        parametric
+    };
+    struct ResamplingConfig
+    {
+        size_t resamples = 1000;
+        ResamplingMethod method = ResamplingMethod::bootstrap;
+        //Periods per resample, 0 uses as many as the history has
+        size_t observations = 0;
+        //Resample i draws from a generator seeded with (seed, i), so a run does not depend on the number of threads
+        unsigned int seed = std::random_device{}();
+        //0 uses every hardware thread
+        size_t threads = 0;
+    };
+    struct ResampledFrontier
+    {
+        std::vector<double> target_returns;
+        //targets x assets, mean of every accepted resample's frontier weights at each target return
+        Matrix<double> weights;
+        //targets x assets, standard deviation of those weights across the accepted resamples
+        Matrix<double> weight_deviation;
+        //Averaged portfolios evaluated with the moments of the full history
+        std::vector<double> expected_return;
+        std::vector<double> volatility;
+        size_t resamples = 0;
+        //Resamples whose covariance was not positive definite, they are left out of the averages
+        size_t rejected = 0;
+    };
+    //Averages the fully invested minimum variance frontier over many resamples of a returns history,
+    //which damps the frontier's sensitivity to estimation noise in the moments.
+    class FrontierResampler
+    {
+    private:
+        std::vector<std::string> tickers;
+        //periods x assets
+        Matrix<double> returns;
+
+    public:
+        FrontierResampler(const std::vector<std::string> &tickers, const std::unordered_map<std::string, std::vector<double>> &historical_returns);
+        FrontierResampler(const std::vector<std::string> &tickers, const Matrix<double> &returns);
+        const std::vector<std::string> &get_tickers() const;
+        //Every resample re-estimates mean and covariance, factors the covariance and adds its frontier weights at each target return
+        ResampledFrontier run(const std::vector<double> &target_returns, const ResamplingConfig &config) const;
+    };
+}
@@ -0,0 +1,89 @@
+#include "risk.hpp"
+#include "linear_algebra.hpp"
+#include <cmath>
+#include <algorithm>
+#include <stdexcept>
+namespace portfolio_optimizer::optimization
+{
+    namespace
+    {
+        //covariance_weights holds covariance * weights on entry and the marginal contributions on exit
+        double decompose_row(const double *weights, double *covariance_weights, double *component, double *percentage, size_t assets)
+        {
+            double variance = dot(weights, covariance_weights, assets);
+            double volatility = std::sqrt(std::max(variance, 0.0));
+            double scale = volatility > 0 ? 1 / volatility : 0;
+            for (size_t i = 0; i < assets; i++)
+            {
+                double marginal = covariance_weights[i] * scale;
+                covariance_weights[i] = marginal;
+                component[i] = weights[i] * marginal;
+                percentage[i] = component[i] * scale;
+            }
+            return volatility;
+        }
+    }
+    RiskDecomposition decompose_risk(const Matrix<double> &covariance, const std::vector<double> &weights)
+    {
+        if (covariance.rows != covariance.cols || covariance.cols != weights.size())
+        {
+            throw std::invalid_argument("Matrix dimensions must agree.");
+        }
+        size_t assets = weights.size();
+        RiskDecomposition result;
+        result.marginal.resize(assets);
+        result.component.resize(assets);
+        result.percentage.resize(assets);
+        gemv(covariance.values(), weights.data(), result.marginal.data(), assets, assets);
+        result.volatility = decompose_row(weights.data(), result.marginal.data(), result.component.data(), result.percentage.data(), assets);
+        return result;
+    }
+    RiskDecomposition decompose_risk(const SymmetricMatrix<double> &covariance, const std::vector<double> &weights)
+    {
+        if (covariance.cols != weights.size())
+        {
+            throw std::invalid_argument("Matrix dimensions must agree.");
+        }
+        size_t assets = weights.size();
+        RiskDecomposition result;
+        result.marginal.resize(assets);
+        result.component.resize(assets);
+        result.percentage.resize(assets);
+        spmv(covariance.values(), weights.data(), result.marginal.data(), assets);
+        result.volatility = decompose_row(weights.data(), result.marginal.data(), result.component.data(), result.percentage.data(), assets);
+        return result;
+    }
+    void decompose_risk(const double *covariance, const double *weights, size_t portfolios, size_t assets,
+                        double *volatility, double *marginal, double *component, double *percentage, size_t threads)
+    {
+        //The covariance is symmetric, so W * cov holds (cov * w)' in every row
+        gemm(weights, covariance, marginal, portfolios, assets, assets, threads);
+        for (size_t k = 0; k < portfolios; k++)
+        {
+            volatility[k] = decompose_row(weights + k * assets, marginal + k * assets, component + k * assets, percentage + k * assets, assets);
+        }
+    }
+    RiskReport decompose_risk(const double *covariance, const double *weights, size_t portfolios, size_t assets, size_t threads)
+    {
+        RiskReport report(portfolios, assets);
+        decompose_risk(covariance, weights, portfolios, assets, report.volatility.data(), report.marginal.values(), report.component.values(),
+                       report.percentage.values(), threads);
+        return report;
+    }
+    void decompose_packed_risk(const double *covariance, const double *weights, size_t portfolios, size_t assets,
+                               double *volatility, double *marginal, double *component, double *percentage, size_t threads)
+    {
+        spmm(weights, covariance, marginal, portfolios, assets, threads);
+        for (size_t k = 0; k < portfolios; k++)
+        {
+            volatility[k] = decompose_row(weights + k * assets, marginal + k * assets, component + k * assets, percentage + k * assets, assets);
+        }
+    }
+    RiskReport decompose_packed_risk(const double *covariance, const double *weights, size_t portfolios, size_t assets, size_t threads)
+    {
+        RiskReport report(portfolios, assets);
+        decompose_packed_risk(covariance, weights, portfolios, assets, report.volatility.data(), report.marginal.values(), report.component.values(),
+                              report.percentage.values(), threads);
+        return report;
+    }
+}
@@ -0,0 +1,72 @@
+#pragma once
+#include "matrix.hpp"
+#include "symmetric_matrix.hpp"
+#include <vector>
+#include <stdexcept>
+namespace portfolio_optimizer::optimization
+{
+    //Euler decomposition of portfolio volatility: component[i] = weights[i] * marginal[i] and the
+    //components add up to the volatility, percentage[i] = component[i] / volatility.
+    typedef struct
+    {
+        double volatility;
+        std::vector<double> marginal;
+        std::vector<double> component;
+        std::vector<double> percentage;
+    } RiskDecomposition;
+    //Decomposition of many portfolios at once, row k of each matrix belongs to portfolio k
+    template <typename Allocator = std::allocator<double>>
+    struct BasicRiskReport
+    {
+        std::vector<double, Allocator> volatility;
+        Matrix<double, Allocator> marginal;
+        Matrix<double, Allocator> component;
+        Matrix<double, Allocator> percentage;
+        BasicRiskReport() = default;
+        BasicRiskReport(const size_t portfolios, const size_t assets, const Allocator &allocator = Allocator())
+            : volatility(portfolios, 0.0, allocator), marginal(portfolios, assets, allocator), component(portfolios, assets, allocator),
+              percentage(portfolios, assets, allocator)
+        {
+        }
+    };
+    typedef BasicRiskReport<> RiskReport;
+    RiskDecomposition decompose_risk(const Matrix<double> &covariance, const std::vector<double> &weights);
+    RiskDecomposition decompose_risk(const SymmetricMatrix<double> &covariance, const std::vector<double> &weights);
+    //weights is portfolios x assets row-major, the covariance products of every portfolio come from a single matrix product.
+    //threads = 0 uses every hardware thread, products too small to repay starting threads run on the caller's thread.
+    //volatility holds portfolios entries, marginal, component and percentage are portfolios x assets row-major.
+    void decompose_risk(const double *covariance, const double *weights, size_t portfolios, size_t assets,
+                        double *volatility, double *marginal, double *component, double *percentage, size_t threads = 1);
+    RiskReport decompose_risk(const double *covariance, const double *weights, size_t portfolios, size_t assets, size_t threads = 1);
+    //The report's storage comes from allocator, e.g. an arena
+    template <typename CovarianceAllocator, typename WeightsAllocator, typename Allocator = std::allocator<double>>
+    BasicRiskReport<Allocator> decompose_risk(const Matrix<double, CovarianceAllocator> &covariance, const Matrix<double, WeightsAllocator> &weights, size_t threads = 1,
+                                              const Allocator &allocator = Allocator())
+    {
+        if (covariance.rows != covariance.cols || covariance.cols != weights.cols)
+        {
+            throw std::invalid_argument("Matrix dimensions must agree.");
+        }
+        BasicRiskReport<Allocator> report(weights.rows, weights.cols, allocator);
+        decompose_risk(covariance.values(), weights.values(), weights.rows, weights.cols, report.volatility.data(), report.marginal.values(),
+                       report.component.values(), report.percentage.values(), threads);
+        return report;
+    }
+    //Same as decompose_risk with the covariance packed as in SymmetricMatrix
+    void decompose_packed_risk(const double *covariance, const double *weights, size_t portfolios, size_t assets,
+                               double *volatility, double *marginal, double *component, double *percentage, size_t threads = 1);
+    RiskReport decompose_packed_risk(const double *covariance, const double *weights, size_t portfolios, size_t assets, size_t threads = 1);
+    template <typename CovarianceAllocator, typename WeightsAllocator, typename Allocator = std::allocator<double>>
+    BasicRiskReport<Allocator> decompose_risk(const SymmetricMatrix<double, CovarianceAllocator> &covariance, const Matrix<double, WeightsAllocator> &weights, size_t threads = 1,
+                                              const Allocator &allocator = Allocator())
+    {
+        if (covariance.cols != weights.cols)
+        {
+            throw std::invalid_argument("Matrix dimensions must agree.");
+        }
+        BasicRiskReport<Allocator> report(weights.rows, weights.cols, allocator);
+        decompose_packed_risk(covariance.values(), weights.values(), weights.rows, weights.cols, report.volatility.data(), report.marginal.values(),
+                              report.component.values(), report.percentage.values(), threads);
+        return report;
+    }
+}
@@ -0,0 +1,172 @@
+#include "risk_parity.hpp"
+#include "linear_algebra.hpp"
+#include <cmath>
+#include <atomic>
+#include <thread>
+#include <algorithm>
+#include <stdexcept>
+namespace portfolio_optimizer::optimization
+{
+    RiskParityResult risk_budgeting(const SymmetricMatrix<double> &covariance, const std::vector<double> &budgets,
+                                    const RiskParityOptions &options, const std::vector<double> &initial_weights)
+    {
+        const size_t n = budgets.size();
+        if (covariance.rows != n)
+        {
+            throw std::invalid_argument("Matrix dimensions must agree.");
+        }
+        if (!initial_weights.empty() && initial_weights.size() != n)
+        {
+            throw std::invalid_argument("Initial weights must have one entry per asset.");
+        }
+        double budget_sum = 0;
+        for (size_t i = 0; i < n; i++)
+        {
+            if (!(budgets[i] > 0))
+            {
+                throw std::invalid_argument("Risk budgets must be positive.");
+            }
+            budget_sum += budgets[i];
+        }
+        std::vector<double> b(n);
+        for (size_t i = 0; i < n; i++)
+        {
+            b[i] = budgets[i] / budget_sum;
+        }
+        //Minimizes y' cov y / 2 - sum(b * log(y)), whose solution satisfies y_i * (cov * y)_i = b_i and y' cov y = 1
+        std::vector<double> y(n);
+        for (size_t i = 0; i < n; i++)
+        {
+            double diagonal = covariance.row(i)[i];
+            if (!(diagonal > 0))
+            {
+                throw std::invalid_argument("Covariance diagonal must be positive.");
+            }
+            bool warm = !initial_weights.empty() && initial_weights[i] > 0;
+            y[i] = warm ? initial_weights[i] : 1 / std::sqrt(diagonal);
+        }
+        //(cov * y)_i splits into the packed row i times y[0, i] and upper[i], the entries below the diagonal of column i
+        //times y(i, n). Coordinate i only changes y[i], so walking the rows in order gets the first part from the
+        //coordinates already moved this sweep and the second from the previous sweep, and the moved y[i] is folded into
+        //the next sweep's upper with row i still in cache.
+        std::vector<double> sigma_y(n);
+        std::vector<double> upper(n, 0.0);
+        std::vector<double> next_upper(n);
+        for (size_t i = 0; i < n; i++)
+        {
+            axpy(y[i], covariance.row(i), upper.data(), i);
+        }
+        spmv(covariance.values(), y.data(), sigma_y.data(), n);
+        double scale = 1 / std::sqrt(dot(y.data(), sigma_y.data(), n));
+        for (size_t i = 0; i < n; i++)
+        {
+            y[i] *= scale;
+            sigma_y[i] *= scale;
+            upper[i] *= scale;
+        }
+        RiskParityResult result;
+        result.converged = false;
+        result.sweeps = 0;
+        while (result.sweeps < options.max_sweeps)
+        {
+            result.sweeps++;
+            std::fill(next_upper.begin(), next_upper.end(), 0.0);
+            for (size_t i = 0; i < n; i++)
+            {
+                const double *row = covariance.row(i);
+                double diagonal = row[i];
+                double lower = dot(row, y.data(), i);
+                double others = lower + upper[i];
+                y[i] = (-others + std::sqrt(others * others + 4 * diagonal * b[i])) / (2 * diagonal);
+                axpy(y[i], row, next_upper.data(), i);
+                sigma_y[i] = lower + diagonal * y[i];
+            }
+            upper.swap(next_upper);
+            double error = 0;
+            for (size_t i = 0; i < n; i++)
+            {
+                sigma_y[i] += upper[i];
+                error = std::max(error, std::abs(y[i] * sigma_y[i] - b[i]) / b[i]);
+            }
+            if (error <= options.tolerance)
+            {
+                result.converged = true;
+                break;
+            }
+        }
+        double total = 0;
+        for (size_t i = 0; i < n; i++)
+        {
+            total += y[i];
+        }
+        result.weights.resize(n);
+        result.risk_contributions.resize(n);
+        double variance = dot(y.data(), sigma_y.data(), n);
+        for (size_t i = 0; i < n; i++)
+        {
+            result.weights[i] = y[i] / total;
+            result.risk_contributions[i] = y[i] * sigma_y[i] / variance;
+        }
+        result.volatility = std::sqrt(variance) / total;
+        return result;
+    }
+    RiskParityResult risk_budgeting(const Matrix<double> &covariance, const std::vector<double> &budgets,
+                                    const RiskParityOptions &options, const std::vector<double> &initial_weights)
+    {
+        return risk_budgeting(SymmetricMatrix<double>(covariance), budgets, options, initial_weights);
+    }
+    std::vector<RiskParityResult> risk_budgeting(const SymmetricMatrix<double> &covariance, const std::vector<std::vector<double>> &budgets,
+                                                 const RiskParityOptions &options, const std::vector<std::vector<double>> &initial_weights,
+                                                 size_t threads)
+    {
+        if (!initial_weights.empty() && initial_weights.size() != budgets.size())
+        {
+            throw std::invalid_argument("Initial weights must have one entry per budget.");
+        }
+        if (threads == 0)
+        {
+            threads = std::max<size_t>(1, std::thread::hardware_concurrency());
+        }
+        threads = std::max<size_t>(1, std::min(threads, budgets.size()));
+        std::vector<RiskParityResult> results(budgets.size());
+        std::vector<std::exception_ptr> errors(budgets.size());
+        std::atomic<size_t> next = 0;
+        std::vector<std::thread> workers(threads);
+        for (size_t t = 0; t < threads; t++)
+        {
+            workers[t] = std::thread([&]()
+            {
+                for (size_t i = next++; i < budgets.size(); i = next++)
+                {
+                    try
+                    {
+                        results[i] = risk_budgeting(covariance, budgets[i], options,
+                                                    initial_weights.empty() ? std::vector<double>() : initial_weights[i]);
+                    }
+                    catch (...)
+                    {
+                        errors[i] = std::current_exception();
+                    }
+                }
+            });
+        }
+        for (size_t t = 0; t < threads; t++)
+        {
+            workers[t].join();
+        }
+        for (size_t i = 0; i < errors.size(); i++)
+        {
+            if (errors[i])
+            {
+                std::rethrow_exception(errors[i]);
+            }
+        }
+        return results;
+    }
+    std::vector<RiskParityResult> risk_budgeting(const Matrix<double> &covariance, const std::vector<std::vector<double>> &budgets,
+                                                 const RiskParityOptions &options, const std::vector<std::vector<double>> &initial_weights,
+                                                 size_t threads)
+    {
+        return risk_budgeting(SymmetricMatrix<double>(covariance), budgets, options, initial_weights, threads);
+    }
+}
@@ -0,0 +1,40 @@
+#pragma once
+#include "matrix.hpp"
+#include "symmetric_matrix.hpp"
+#include <vector>
+namespace portfolio_optimizer::optimization
+{
+    struct RiskParityOptions
+    {
+        size_t max_sweeps = 1000;
+        //Largest relative gap allowed between a risk contribution and its budget
+        double tolerance = 1e-10;
+    };
+    typedef struct
+    {
+        std::vector<double> weights;
+        double volatility;
+        //Share of the variance carried by every asset, matches the normalized budgets on convergence
+        std::vector<double> risk_contributions;
+        size_t sweeps;
+        bool converged;
+    } RiskParityResult;
+    //Long-only risk budgeting portfolio by cyclical coordinate descent. Every sweep reads each packed row of the
+    //covariance once, so it costs O(N^2). initial_weights (e.g. yesterday's portfolio) warm-starts the descent,
+    //empty starts from inverse volatility weights. Equal budgets give the equal risk contribution portfolio.
+    RiskParityResult risk_budgeting(const SymmetricMatrix<double> &covariance, const std::vector<double> &budgets,
+                                    const RiskParityOptions &options = RiskParityOptions(),
+                                    const std::vector<double> &initial_weights = std::vector<double>());
+    RiskParityResult risk_budgeting(const Matrix<double> &covariance, const std::vector<double> &budgets,
+                                    const RiskParityOptions &options = RiskParityOptions(),
+                                    const std::vector<double> &initial_weights = std::vector<double>());
+    //One portfolio per budget vector, solved in parallel. threads = 0 uses every hardware thread
+    std::vector<RiskParityResult> risk_budgeting(const SymmetricMatrix<double> &covariance, const std::vector<std::vector<double>> &budgets,
+                                                 const RiskParityOptions &options = RiskParityOptions(),
+                                                 const std::vector<std::vector<double>> &initial_weights = std::vector<std::vector<double>>(),
+                                                 size_t threads = 0);
+    std::vector<RiskParityResult> risk_budgeting(const Matrix<double> &covariance, const std::vector<std::vector<double>> &budgets,
+                                                 const RiskParityOptions &options = RiskParityOptions(),
+                                                 const std::vector<std::vector<double>> &initial_weights = std::vector<std::vector<double>>(),
+                                                 size_t threads = 0);
+}
@@ -0,0 +1,324 @@
+#include "streaming_covariance.hpp"
+#include "linear_algebra.hpp"
+#include <cmath>
+#include <thread>
+#include <cstring>
+#include <limits>
+#include <algorithm>
+#include <stdexcept>
+#include <exception>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+namespace portfolio_optimizer::optimization
+{
+    namespace
+    {
+        constexpr size_t min_block_rows = 256;
+        constexpr size_t block_bytes = 1 << 22;
+        //Rows of the transposed block handled together, their destinations stay in L1 while a block row is read once
+        constexpr size_t transpose_tile = 64;
+        //Hands out consecutive blocks of rows. The panel is mapped where possible, so a block is read straight from the
+        //page cache and its pages are dropped once transposed; otherwise blocks are read into a buffer.
+        class PanelReader
+        {
+        private:
+            std::string path;
+            std::FILE *file = nullptr;
+            size_t assets = 0;
+            size_t observations = 0;
+            std::vector<double> buffer;
+#ifndef _WIN32
+            const char *mapped = nullptr;
+            size_t mapped_size = 0;
+            size_t released = 0;
+#endif
+
+        public:
+            PanelReader(const std::string &path) : path(path)
+            {
+                file = std::fopen(path.c_str(), "rb");
+                if (file == nullptr)
+                {
+                    throw std::runtime_error("Failed to open " + path);
+                }
+                ReturnsPanelHeader header;
+                if (std::fread(&header, sizeof(header), 1, file) != 1 || std::memcmp(header.magic, returns_panel_magic, sizeof(header.magic)) != 0)
+                {
+                    std::fclose(file);
+                    throw std::runtime_error(path + " is not a returns panel.");
+                }
+                //The header is untrusted, its sizes must describe a panel whose byte size fits in size_t
+                constexpr size_t max_values = (std::numeric_limits<size_t>::max() - sizeof(header)) / sizeof(double);
+                if (header.assets == 0 || header.assets > max_values || header.observations > max_values / header.assets)
+                {
+                    std::fclose(file);
+                    throw std::runtime_error(path + " has an invalid returns panel header.");
+                }
+                assets = static_cast<size_t>(header.assets);
+                observations = static_cast<size_t>(header.observations);
+                const size_t size = sizeof(header) + observations * assets * sizeof(double);
+#ifndef _WIN32
+                struct stat info;
+                if (fstat(fileno(file), &info) != 0 || static_cast<size_t>(info.st_size) < size)
+                {
+                    std::fclose(file);
+                    throw std::runtime_error(path + " is truncated.");
+                }
+                void *region = size > 0 ? mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fileno(file), 0) : MAP_FAILED;
+                if (region != MAP_FAILED)
+                {
+                    madvise(region, size, MADV_SEQUENTIAL);
+                    mapped = static_cast<const char *>(region);
+                    mapped_size = size;
+                }
+#endif
+            }
+            PanelReader(const PanelReader &) = delete;
+            PanelReader &operator=(const PanelReader &) = delete;
+            ~PanelReader()
+            {
+#ifndef _WIN32
+                if (mapped != nullptr)
+                {
+                    munmap(const_cast<char *>(mapped), mapped_size);
+                }
+#endif
+                std::fclose(file);
+            }
+            size_t size() const
+            {
+                return assets;
+            }
+            size_t count() const
+            {
+                return observations;
+            }
+            //count x assets row-major, valid until the next call
+            const double *rows(const size_t first, const size_t count)
+            {
+#ifndef _WIN32
+                if (mapped != nullptr)
+                {
+                    return reinterpret_cast<const double *>(mapped + sizeof(ReturnsPanelHeader)) + first * assets;
+                }
+#endif
+                buffer.resize(count * assets);
+                if (std::fread(buffer.data(), sizeof(double), buffer.size(), file) != buffer.size())
+                {
+                    throw std::runtime_error("Failed to read " + path);
+                }
+                return buffer.data();
+            }
+            //Rows before last have been transposed and are not read again
+            void release(const size_t last)
+            {
+#ifndef _WIN32
+                if (mapped == nullptr)
+                {
+                    return;
+                }
+                const size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+                const size_t end = (sizeof(ReturnsPanelHeader) + last * assets * sizeof(double)) / page * page;
+                if (end > released)
+                {
+                    madvise(const_cast<char *>(mapped) + released, end - released, MADV_DONTNEED);
+                    released = end;
+                }
+#endif
+            }
+        };
+        //Transposes a count x assets block into assets x count, shifted by the first observation of the panel so the
+        //cross-products of nearly constant columns keep their precision. Adds the shifted block's column sums to sums.
+        void transpose(const double *rows, const size_t count, const size_t assets, const double *shift, double *sums, double *transposed)
+        {
+            for (size_t i0 = 0; i0 < assets; i0 += transpose_tile)
+            {
+                const size_t i1 = std::min(assets, i0 + transpose_tile);
+                for (size_t t = 0; t < count; t++)
+                {
+                    const double *row = rows + t * assets;
+                    for (size_t i = i0; i < i1; i++)
+                    {
+                        double value = row[i] - shift[i];
+                        transposed[i * count + t] = value;
+                        sums[i] += value;
+                    }
+                }
+            }
+        }
+    }
+    ReturnsPanelWriter::ReturnsPanelWriter(const std::string &path, const size_t assets)
+    {
+        this->assets = assets;
+        file = std::fopen(path.c_str(), "wb");
+        if (file == nullptr)
+        {
+            throw std::runtime_error("Failed to open " + path);
+        }
+        ReturnsPanelHeader header;
+        std::memcpy(header.magic, returns_panel_magic, sizeof(header.magic));
+        header.assets = assets;
+        header.observations = 0;
+        if (std::fwrite(&header, sizeof(header), 1, file) != 1)
+        {
+            std::fclose(file);
+            file = nullptr;
+            throw std::runtime_error("Failed to write " + path);
+        }
+    }
+    ReturnsPanelWriter::~ReturnsPanelWriter()
+    {
+        try
+        {
+            finish();
+        }
+        catch (...)
+        {
+        }
+    }
+    void ReturnsPanelWriter::append(const double *rows, const size_t count)
+    {
+        if (file == nullptr)
+        {
+            throw std::runtime_error("Returns panel is already finished.");
+        }
+        if (std::fwrite(rows, sizeof(double), count * assets, file) != count * assets)
+        {
+            throw std::runtime_error("Failed to write returns panel.");
+        }
+        observations += count;
+    }
+    void ReturnsPanelWriter::append(const Matrix<double> &rows)
+    {
+        if (rows.cols != assets)
+        {
+            throw std::invalid_argument("Matrix dimensions must agree.");
+        }
+        append(rows.values(), rows.rows);
+    }
+    void ReturnsPanelWriter::finish()
+    {
+        if (file == nullptr)
+        {
+            return;
+        }
+        ReturnsPanelHeader header;
+        std::memcpy(header.magic, returns_panel_magic, sizeof(header.magic));
+        header.assets = assets;
+        header.observations = observations;
+        bool written = std::fseek(file, 0, SEEK_SET) == 0 && std::fwrite(&header, sizeof(header), 1, file) == 1;
+        written = std::fclose(file) == 0 && written;
+        file = nullptr;
+        if (!written)
+        {
+            throw std::runtime_error("Failed to write returns panel.");
+        }
+    }
+    size_t ReturnsPanelWriter::size() const
+    {
+        return assets;
+    }
+    size_t ReturnsPanelWriter::count() const
+    {
+        return observations;
+    }
+    void write_returns_panel(const std::string &path, const Matrix<double> &returns)
+    {
+        ReturnsPanelWriter writer(path, returns.cols);
+        writer.append(returns);
+        writer.finish();
+    }
+    StreamingCovariance streaming_covariance(const std::string &path, const StreamingCovarianceConfig &config)
+    {
+        PanelReader reader(path);
+        const size_t assets = reader.size();
+        const size_t observations = reader.count();
+        if (observations < 2)
+        {
+            throw std::invalid_argument("At least two observations are needed.");
+        }
+        size_t block_rows = config.block_rows;
+        if (block_rows == 0)
+        {
+            block_rows = std::max(min_block_rows, block_bytes / sizeof(double) / std::max<size_t>(1, assets));
+        }
+        block_rows = std::min(block_rows, observations);
+        size_t threads = config.threads;
+        if (threads == 0)
+        {
+            threads = std::max<size_t>(1, std::thread::hardware_concurrency());
+        }
+        //Bands under 32 rows would split packed_rank_k_update's own row blocks
+        threads = std::max<size_t>(1, std::min(threads, (assets + 31) / 32));
+        //Row r of the packed triangle costs r + 1, so band t ends where the area reaches (t + 1) / threads of the total
+        std::vector<size_t> bands(threads + 1);
+        for (size_t t = 0; t <= threads; t++)
+        {
+            bands[t] = std::min(assets, static_cast<size_t>(std::llround(assets * std::sqrt(static_cast<double>(t) / threads))));
+        }
+        std::vector<double> sums(assets, 0.0);
+        //Holds -sum of x * x^T of the shifted observations, packed_rank_k_update subtracts
+        SymmetricMatrix<double> cross_products(assets);
+        //The next block is read and transposed into one panel while the workers accumulate the other
+        std::vector<double> panels[2] = {std::vector<double>(assets * block_rows), std::vector<double>(assets * block_rows)};
+        const size_t blocks = (observations + block_rows - 1) / block_rows;
+        const double *rows = reader.rows(0, block_rows);
+        std::vector<double> shift(rows, rows + assets);
+        transpose(rows, block_rows, assets, shift.data(), sums.data(), panels[0].data());
+        reader.release(block_rows);
+        for (size_t b = 0; b < blocks; b++)
+        {
+            const size_t first = b * block_rows;
+            const size_t count = std::min(block_rows, observations - first);
+            const double *panel = panels[b % 2].data();
+            std::vector<std::thread> workers(threads);
+            for (size_t t = 0; t < threads; t++)
+            {
+                workers[t] = std::thread(packed_rank_k_update, panel, cross_products.values(), bands[t + 1], count, bands[t]);
+            }
+            std::exception_ptr error;
+            if (b + 1 < blocks)
+            {
+                try
+                {
+                    const size_t next = first + count;
+                    const size_t next_count = std::min(block_rows, observations - next);
+                    transpose(reader.rows(next, next_count), next_count, assets, shift.data(), sums.data(), panels[(b + 1) % 2].data());
+                    reader.release(next + next_count);
+                }
+                catch (...)
+                {
+                    error = std::current_exception();
+                }
+            }
+            for (size_t t = 0; t < threads; t++)
+            {
+                workers[t].join();
+            }
+            if (error)
+            {
+                std::rethrow_exception(error);
+            }
+        }
+        StreamingCovariance result;
+        result.observations = observations;
+        result.mean.resize(assets);
+        result.covariance = SymmetricMatrix<double>(assets);
+        const double n = static_cast<double>(observations);
+        for (size_t i = 0; i < assets; i++)
+        {
+            result.mean[i] = shift[i] + sums[i] / n;
+            const double *cross_row = cross_products.row(i);
+            double *row = result.covariance.row(i);
+            for (size_t j = 0; j <= i; j++)
+            {
+                row[j] = (-cross_row[j] - sums[i] * sums[j] / n) / (n - 1);
+            }
+        }
+        return result;
+    }
+}
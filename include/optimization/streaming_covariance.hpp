@@ -0,0 +1,57 @@
+#pragma once
+#include "matrix.hpp"
+#include "symmetric_matrix.hpp"
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <cstdint>
+namespace portfolio_optimizer::optimization
+{
+    //Binary returns panel on disk: this header, then observations x assets doubles row-major in native byte order
+    struct ReturnsPanelHeader
+    {
+        char magic[8];
+        uint64_t assets;
+        uint64_t observations;
+    };
+    constexpr char returns_panel_magic[8] = {'P', 'O', 'R', 'E', 'T', 'P', 'N', '1'};
+    //Appends observations to a returns panel file. The observation count in the header is written by finish,
+    //so a panel can be produced one row at a time without knowing its length up front.
+    class ReturnsPanelWriter
+    {
+    private:
+        std::FILE *file = nullptr;
+        size_t assets = 0;
+        size_t observations = 0;
+
+    public:
+        ReturnsPanelWriter(const std::string &path, const size_t assets);
+        ReturnsPanelWriter(const ReturnsPanelWriter &) = delete;
+        ReturnsPanelWriter &operator=(const ReturnsPanelWriter &) = delete;
+        ~ReturnsPanelWriter();
+        //rows x assets row-major
+        void append(const double *rows, const size_t count = 1);
+        void append(const Matrix<double> &rows);
+        void finish();
+        size_t size() const;
+        size_t count() const;
+    };
+    void write_returns_panel(const std::string &path, const Matrix<double> &returns);
+    struct StreamingCovarianceConfig
+    {
+        //Observations read and accumulated at once, 0 reads about 4 MiB and at least 256 observations per block
+        size_t block_rows = 0;
+        //0 uses every hardware thread
+        size_t threads = 0;
+    };
+    struct StreamingCovariance
+    {
+        size_t observations = 0;
+        std::vector<double> mean;
+        SymmetricMatrix<double> covariance;
+    };
+    //Sample mean and covariance of a returns panel that does not have to fit in memory. The panel is read block by block
+    //(mapped where the platform allows it) and every block is a rank-k update of the packed cross-products, whose rows are
+    //split into bands of equal work across threads while the next block is read. Memory is O(assets^2) for any history length.
+    StreamingCovariance streaming_covariance(const std::string &path, const StreamingCovarianceConfig &config = StreamingCovarianceConfig());
+}
@@ -0,0 +1,219 @@
+#pragma once
+#include "matrix.hpp"
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <stdexcept>
+#include <type_traits>
+namespace portfolio_optimizer::optimization
+{
+    //Symmetric matrix that stores only its lower triangle, packed row by row: row i holds entries (i, 0) to (i, i)
+    //and starts at offset(i) = i * (i + 1) / 2. Half the memory of a dense Matrix, and every kernel reads each stored
+    //entry once. Rows are prefixes of a larger matrix's rows, so a leading block is a prefix of the packed values.
+    template <typename T, typename Allocator = std::allocator<T>>
+    class SymmetricMatrix
+    {
+    private:
+        std::vector<T, Allocator> data;
+
+    public:
+        size_t rows;
+        size_t cols;
+        static size_t offset(const size_t row)
+        {
+            return row * (row + 1) / 2;
+        }
+        static size_t packed_size(const size_t size)
+        {
+            return offset(size);
+        }
+        SymmetricMatrix(const Allocator &allocator = Allocator()) : data(allocator)
+        {
+            this->rows = 0;
+            this->cols = 0;
+        }
+        SymmetricMatrix(const size_t size, const Allocator &allocator = Allocator()) : data(packed_size(size), T(), allocator)
+        {
+            this->rows = size;
+            this->cols = size;
+        }
+        //Only the lower triangle of matrix is read
+        template <typename MatrixAllocator>
+        explicit SymmetricMatrix(const Matrix<T, MatrixAllocator> &matrix, const Allocator &allocator = Allocator()) : data(allocator)
+        {
+            if (matrix.rows != matrix.cols)
+            {
+                throw std::invalid_argument("Matrix must be square.");
+            }
+            this->rows = matrix.rows;
+            this->cols = matrix.cols;
+            data.resize(packed_size(rows));
+            for (size_t i = 0; i < rows; i++)
+            {
+                const T *source = matrix.values() + i * cols;
+                std::copy(source, source + i + 1, data.data() + offset(i));
+            }
+        }
+        Allocator get_allocator() const
+        {
+            return data.get_allocator();
+        }
+        size_t size() const
+        {
+            return rows;
+        }
+        template <typename MatrixAllocator = std::allocator<T>>
+        Matrix<T, MatrixAllocator> to_matrix(const MatrixAllocator &allocator = MatrixAllocator()) const
+        {
+            Matrix<T, MatrixAllocator> result(rows, cols, allocator);
+            T *values = result.values();
+            for (size_t i = 0; i < rows; i++)
+            {
+                const T *row = data.data() + offset(i);
+                for (size_t j = 0; j <= i; j++)
+                {
+                    values[i * cols + j] = row[j];
+                    values[j * cols + i] = row[j];
+                }
+            }
+            return result;
+        }
+        //Either triangle can be addressed, both map to the same stored entry
+        T &operator()(const size_t row, const size_t col)
+        {
+            return row >= col ? data[offset(row) + col] : data[offset(col) + row];
+        }
+        const T &operator()(const size_t row, const size_t col) const
+        {
+            return row >= col ? data[offset(row) + col] : data[offset(col) + row];
+        }
+        //Packed storage, row i starts at values() + offset(i) and holds i + 1 entries
+        T *values()
+        {
+            return data.data();
+        }
+        const T *values() const
+        {
+            return data.data();
+        }
+        T *row(const size_t row)
+        {
+            return data.data() + offset(row);
+        }
+        const T *row(const size_t row) const
+        {
+            return data.data() + offset(row);
+        }
+        //Adds one row and column: row holds the new entry's off-diagonal entries followed by its diagonal entry
+        void append(const T *row)
+        {
+            data.insert(data.end(), row, row + rows + 1);
+            rows++;
+            cols++;
+        }
+        //Drops row and column index, later packed rows move towards the front
+        void remove(const size_t index)
+        {
+            if (index >= rows)
+            {
+                throw std::invalid_argument("Row or column index out of bounds.");
+            }
+            T *values = data.data();
+            for (size_t i = index + 1; i < rows; i++)
+            {
+                const T *source = values + offset(i);
+                T *destination = values + offset(i - 1);
+                std::copy(source, source + index, destination);
+                std::copy(source + index + 1, source + i + 1, destination + index);
+            }
+            rows--;
+            cols--;
+            data.resize(packed_size(rows));
+        }
+        //A += alpha * x * x^T. Double matrices run the dispatched kernels of linear_algebra.hpp, like Matrix
+        void update(const T *x, const T alpha)
+        {
+            if constexpr (std::is_same_v<T, double>)
+            {
+                packed_rank_one_update(alpha, x, data.data(), rows);
+            }
+            else
+            {
+                for (size_t i = 0; i < rows; i++)
+                {
+                    T *row = data.data() + offset(i);
+                    T value = alpha * x[i];
+                    for (size_t j = 0; j <= i; j++)
+                    {
+                        row[j] += value * x[j];
+                    }
+                }
+            }
+        }
+        //y = A * x. Row i's strictly lower part contributes to y[i] as a row and to y[0, i) as column i.
+        void multiply(const T *x, T *y) const
+        {
+            if constexpr (std::is_same_v<T, double>)
+            {
+                spmv(data.data(), x, y, rows);
+            }
+            else
+            {
+                std::fill(y, y + rows, T());
+                for (size_t i = 0; i < rows; i++)
+                {
+                    const T *row = data.data() + offset(i);
+                    T value = x[i];
+                    T sum = row[i] * value;
+                    for (size_t j = 0; j < i; j++)
+                    {
+                        sum += row[j] * x[j];
+                        y[j] += row[j] * value;
+                    }
+                    y[i] += sum;
+                }
+            }
+        }
+        std::vector<T> operator*(const std::vector<T> &x) const
+        {
+            if (x.size() != cols)
+            {
+                throw std::invalid_argument("Matrix dimensions must agree.");
+            }
+            std::vector<T> result(rows);
+            multiply(x.data(), result.data());
+            return result;
+        }
+        //x' * A * x, each packed row's strictly lower part is dotted with x once and counted twice
+        T quadratic_form(const T *x) const
+        {
+            T result = 0;
+            for (size_t i = 0; i < rows; i++)
+            {
+                const T *row = data.data() + offset(i);
+                T sum = 0;
+                if constexpr (std::is_same_v<T, double>)
+                {
+                    sum = dot(row, x, i);
+                }
+                else
+                {
+                    for (size_t j = 0; j < i; j++)
+                    {
+                        sum += row[j] * x[j];
+                    }
+                }
+                result += x[i] * (2 * sum + row[i] * x[i]);
+            }
+            return result;
+        }
+        T quadratic_form(const std::vector<T> &x) const
+        {
+            if (x.size() != cols)
+            {
+                throw std::invalid_argument("Matrix dimensions must agree.");
+            }
+            return quadratic_form(x.data());
+        }
+    };
+}
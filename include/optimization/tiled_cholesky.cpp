@@ -0,0 +1,261 @@
+#include "tiled_cholesky.hpp"
+#include "linear_algebra.hpp"
+#include <cmath>
+#include <mutex>
+#include <queue>
+#include <tuple>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+#include <exception>
+#include <condition_variable>
+namespace portfolio_optimizer::optimization
+{
+    namespace
+    {
+        constexpr size_t b = cholesky_tile;
+        //Update of tile (i, j) by column k when k < j, the tile's own POTRF or TRSM when k == j
+        struct Task
+        {
+            size_t i;
+            size_t j;
+            size_t k;
+        };
+        //Earlier columns first, they are on the critical path of everything to their right
+        struct Later
+        {
+            bool operator()(const Task &x, const Task &y) const
+            {
+                return std::tie(x.k, x.j, x.i) > std::tie(y.k, y.j, y.i);
+            }
+        };
+        //In-place unblocked factorization of the lower triangle of a diagonal tile
+        void factor_tile(double *a)
+        {
+            for (size_t i = 0; i < b; i++)
+            {
+                double *row_i = a + i * b;
+                for (size_t j = 0; j <= i; j++)
+                {
+                    const double *row_j = a + j * b;
+                    double sum = row_i[j] - dot(row_i, row_j, j);
+                    if (i == j)
+                    {
+                        if (!(sum > 0))
+                        {
+                            throw std::invalid_argument("Matrix must be positive definite.");
+                        }
+                        row_i[i] = std::sqrt(sum);
+                    }
+                    else
+                    {
+                        row_i[j] = sum / row_j[j];
+                    }
+                }
+            }
+        }
+        //a = a * l^-T, every row of a is a forward substitution with l
+        void solve_tile(const double *l, double *a)
+        {
+            for (size_t r = 0; r < b; r++)
+            {
+                double *x = a + r * b;
+                for (size_t c = 0; c < b; c++)
+                {
+                    x[c] = (x[c] - dot(l + c * b, x, c)) / l[c * b + c];
+                }
+            }
+        }
+        class TileFactorization
+        {
+        private:
+            size_t tiles;
+            //Lower tiles only, tile (i, j) is b x b row-major at (i * (i + 1) / 2 + j) * b * b
+            std::vector<double> storage;
+            //Unfinished predecessors of every task. Tasks are numbered row by row of tiles and then by k, so the tasks
+            //of the rows above i come first: i (i + 1) (i + 2) / 6 of them
+            std::vector<std::atomic<size_t>> pending;
+            std::priority_queue<Task, std::vector<Task>, Later> ready;
+            size_t remaining = 0;
+            std::exception_ptr error;
+            std::mutex mutex;
+            std::condition_variable changed;
+
+            double *tile(size_t i, size_t j)
+            {
+                return storage.data() + (i * (i + 1) / 2 + j) * b * b;
+            }
+            std::atomic<size_t> &predecessors(size_t i, size_t j, size_t k)
+            {
+                return pending[i * (i + 1) * (i + 2) / 6 + j * (j + 1) / 2 + k];
+            }
+            void release(size_t i, size_t j, size_t k, std::vector<Task> &unlocked)
+            {
+                if (predecessors(i, j, k).fetch_sub(1, std::memory_order_acq_rel) == 1)
+                {
+                    unlocked.push_back({i, j, k});
+                }
+            }
+            void run(const Task &task)
+            {
+                if (task.k < task.j)
+                {
+                    rank_k_update(tile(task.i, task.k), tile(task.j, task.k), tile(task.i, task.j), b, b, b);
+                }
+                else if (task.i == task.j)
+                {
+                    factor_tile(tile(task.j, task.j));
+                }
+                else
+                {
+                    solve_tile(tile(task.j, task.j), tile(task.i, task.j));
+                }
+            }
+            void complete(const Task &task)
+            {
+                std::vector<Task> unlocked;
+                if (task.k < task.j)
+                {
+                    release(task.i, task.j, task.k + 1, unlocked);
+                }
+                else if (task.i == task.j)
+                {
+                    for (size_t m = task.j + 1; m < tiles; m++)
+                    {
+                        release(m, task.j, task.j, unlocked);
+                    }
+                }
+                else
+                {
+                    //Tile (i, k) is final, every trailing tile in row i or column i can take its update by k
+                    for (size_t q = task.j + 1; q <= task.i; q++)
+                    {
+                        release(task.i, q, task.j, unlocked);
+                    }
+                    for (size_t p = task.i + 1; p < tiles; p++)
+                    {
+                        release(p, task.i, task.j, unlocked);
+                    }
+                }
+                std::lock_guard<std::mutex> lock(mutex);
+                for (const Task &next : unlocked)
+                {
+                    ready.push(next);
+                }
+                remaining--;
+                changed.notify_all();
+            }
+            void work()
+            {
+                while (true)
+                {
+                    Task task;
+                    {
+                        std::unique_lock<std::mutex> lock(mutex);
+                        changed.wait(lock, [&]() { return !ready.empty() || remaining == 0 || error; });
+                        if (error || ready.empty())
+                        {
+                            return;
+                        }
+                        task = ready.top();
+                        ready.pop();
+                    }
+                    try
+                    {
+                        run(task);
+                    }
+                    catch (...)
+                    {
+                        std::lock_guard<std::mutex> lock(mutex);
+                        error = std::current_exception();
+                        changed.notify_all();
+                        return;
+                    }
+                    complete(task);
+                }
+            }
+
+        public:
+            TileFactorization(size_t tiles) : tiles(tiles), storage(tiles * (tiles + 1) / 2 * b * b, 0.0), pending(tiles * (tiles + 1) * (tiles + 2) / 6)
+            {
+                for (size_t i = 0; i < tiles; i++)
+                {
+                    for (size_t j = 0; j <= i; j++)
+                    {
+                        //Updates of a tile run in column order so the result does not depend on the schedule
+                        for (size_t k = 0; k < j; k++)
+                        {
+                            predecessors(i, j, k) = (k > 0) + 1 + (i != j);
+                        }
+                        predecessors(i, j, j) = (j > 0) + (i != j);
+                        remaining += j + 1;
+                    }
+                }
+                ready.push({0, 0, 0});
+            }
+            void load(const double *packed, size_t n)
+            {
+                for (size_t r = 0; r < tiles * b; r++)
+                {
+                    if (r >= n)
+                    {
+                        //Identity padding factors to itself and leaves the leading block alone
+                        tile(r / b, r / b)[(r % b) * b + r % b] = 1;
+                        continue;
+                    }
+                    const double *row = packed + r * (r + 1) / 2;
+                    for (size_t c = 0; c <= r; c++)
+                    {
+                        tile(r / b, c / b)[(r % b) * b + c % b] = row[c];
+                    }
+                }
+            }
+            void store(double *packed, size_t n)
+            {
+                for (size_t r = 0; r < n; r++)
+                {
+                    double *row = packed + r * (r + 1) / 2;
+                    for (size_t c = 0; c <= r; c++)
+                    {
+                        row[c] = tile(r / b, c / b)[(r % b) * b + c % b];
+                    }
+                }
+            }
+            void factor(size_t threads)
+            {
+                std::vector<std::thread> workers(threads - 1);
+                for (size_t t = 0; t + 1 < threads; t++)
+                {
+                    workers[t] = std::thread(&TileFactorization::work, this);
+                }
+                work();
+                for (size_t t = 0; t + 1 < threads; t++)
+                {
+                    workers[t].join();
+                }
+                if (error)
+                {
+                    std::rethrow_exception(error);
+                }
+            }
+        };
+    }
+    void tiled_cholesky(double *packed, size_t n, size_t threads)
+    {
+        if (n == 0)
+        {
+            return;
+        }
+        if (threads == 0)
+        {
+            threads = std::max<size_t>(1, std::thread::hardware_concurrency());
+        }
+        size_t tiles = (n + b - 1) / b;
+        TileFactorization factorization(tiles);
+        factorization.load(packed, n);
+        factorization.factor(std::min(threads, tiles * tiles));
+        factorization.store(packed, n);
+    }
+}
@@ -0,0 +1,15 @@
+#pragma once
+#include <cstddef>
+namespace portfolio_optimizer::optimization
+{
+    //Cholesky switches to the tiled factorization from this size on, where it already keeps up on a single thread
+    constexpr size_t tiled_cholesky_threshold = 768;
+    //Edge of a tile, three tiles of doubles fit in a 512 KiB L2
+    constexpr size_t cholesky_tile = 128;
+    //Factors the packed lower triangle (see SymmetricMatrix) in place into L, packed the same way.
+    //The matrix is split into cholesky_tile square tiles and every tile operation (POTRF on a diagonal tile,
+    //TRSM below it, SYRK and GEMM trailing updates) is a task that runs as soon as the tiles it reads are final,
+    //so later columns start while earlier ones are still being updated. threads = 0 uses every hardware thread.
+    //Throws std::invalid_argument when the matrix is not positive definite.
+    void tiled_cholesky(double *packed, size_t n, size_t threads = 0);
+}
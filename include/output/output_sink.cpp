@@ -0,0 +1,477 @@
+#include "output_sink.hpp"
+#include "../data/date_utils.hpp"
+#include <cmath>
+#include <cerrno>
+#include <cstring>
+#include <charconv>
+#include <algorithm>
+#include <stdexcept>
+#ifdef _WIN32
+#include <io.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+namespace portfolio_optimizer::output
+{
+    namespace
+    {
+        constexpr int64_t seconds_per_day = 86400;
+        // Offsets are probed a fortnight apart, no time zone changes its offset and back faster than that
+        constexpr int64_t probe_step = 14 * seconds_per_day;
+        constexpr int probe_count = 26;
+        // Walks from time in steps of direction * probe_step and returns a time that still has offset, within a
+        // day of the first change or up to a year away
+        std::time_t same_offset_until(const std::time_t &time, int64_t direction, int64_t offset)
+        {
+            std::time_t inside = time;
+            for (int step = 0; step < probe_count; step++)
+            {
+                std::time_t outside = inside + direction * probe_step;
+                if (data::utc_offset(outside) == offset)
+                {
+                    inside = outside;
+                    continue;
+                }
+                while (outside - inside > seconds_per_day || inside - outside > seconds_per_day)
+                {
+                    std::time_t middle = inside + (outside - inside) / 2;
+                    if (data::utc_offset(middle) == offset)
+                    {
+                        inside = middle;
+                    }
+                    else
+                    {
+                        outside = middle;
+                    }
+                }
+                break;
+            }
+            return inside;
+        }
+        // Decimal text of value when it round-trips with at most fixed_decimals decimals, the common case for
+        // prices and weights, which avoids the shortest round-trip search of std::to_chars
+        constexpr int fixed_decimals = 6;
+        constexpr double fixed_scale = 1e6;
+        char *write_fixed(char *output, double value)
+        {
+            double magnitude = std::abs(value);
+            // Below 1e9 two values with 6 decimals are further apart than a rounding error, so the text is also the shortest one
+            if (!(magnitude < 1e9 && (magnitude >= 1e-3 || value == 0)))
+            {
+                return nullptr;
+            }
+            double scaled = std::round(value * fixed_scale);
+            if (scaled / fixed_scale != value)
+            {
+                return nullptr;
+            }
+            int64_t units = static_cast<int64_t>(std::abs(scaled));
+            if (scaled < 0)
+            {
+                *output++ = '-';
+            }
+            output = std::to_chars(output, output + 20, units / static_cast<int64_t>(fixed_scale)).ptr;
+            unsigned fraction = static_cast<unsigned>(units % static_cast<int64_t>(fixed_scale));
+            if (fraction == 0)
+            {
+                return output;
+            }
+            int digits = fixed_decimals;
+            while (fraction % 10 == 0)
+            {
+                fraction /= 10;
+                digits--;
+            }
+            *output++ = '.';
+            for (int i = digits - 1; i >= 0; i--)
+            {
+                output[i] = static_cast<char>('0' + fraction % 10);
+                fraction /= 10;
+            }
+            return output + digits;
+        }
+        char *write_digits(char *output, unsigned value, int digits)
+        {
+            for (int i = digits - 1; i >= 0; i--)
+            {
+                output[i] = static_cast<char>('0' + value % 10);
+                value /= 10;
+            }
+            return output + digits;
+        }
+    }
+    char *DateFormatter::format(const std::time_t &time, char *output)
+    {
+        if (time > valid_until)
+        {
+            offset = data::utc_offset(time);
+            valid_from = time;
+            valid_until = same_offset_until(time, 1, offset);
+        }
+        else if (time < valid_from)
+        {
+            offset = data::utc_offset(time);
+            valid_until = time;
+            valid_from = same_offset_until(time, -1, offset);
+        }
+        int64_t local = static_cast<int64_t>(time) + offset;
+        int64_t days = local >= 0 ? local / seconds_per_day : (local - seconds_per_day + 1) / seconds_per_day;
+        // Inverse of data::days_from_civil
+        days += 719468;
+        const int64_t era = (days >= 0 ? days : days - 146096) / 146097;
+        const unsigned doe = static_cast<unsigned>(days - era * 146097);
+        const unsigned yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+        const unsigned doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+        const unsigned mp = (5 * doy + 2) / 153;
+        const unsigned day = doy - (153 * mp + 2) / 5 + 1;
+        const unsigned month = mp < 10 ? mp + 3 : mp - 9;
+        const int64_t year = static_cast<int64_t>(yoe) + era * 400 + (month <= 2);
+        output = write_digits(output, static_cast<unsigned>(year), 4);
+        *output++ = '-';
+        output = write_digits(output, month, 2);
+        *output++ = '-';
+        return write_digits(output, day, 2);
+    }
+    OutputSink::OutputSink(const int fd, const size_t buffer_size)
+    {
+        this->fd = fd;
+        this->owned = false;
+        this->buffer.resize(std::max<size_t>(buffer_size, 4096));
+    }
+    OutputSink::OutputSink(const std::string &path, const size_t buffer_size)
+    {
+#ifdef _WIN32
+        this->fd = _open(path.c_str(), _O_WRONLY | _O_CREAT | _O_TRUNC | _O_BINARY, _S_IREAD | _S_IWRITE);
+#else
+        this->fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+#endif
+        if (this->fd < 0)
+        {
+            throw std::runtime_error("Failed to open " + path);
+        }
+        this->owned = true;
+        this->buffer.resize(std::max<size_t>(buffer_size, 4096));
+    }
+    OutputSink::~OutputSink()
+    {
+        try
+        {
+            flush();
+        }
+        catch (...)
+        {
+        }
+        if (owned)
+        {
+#ifdef _WIN32
+            _close(fd);
+#else
+            close(fd);
+#endif
+        }
+    }
+    void OutputSink::write_all(const char *data, size_t size)
+    {
+        while (size > 0)
+        {
+#ifdef _WIN32
+            int written = _write(fd, data, static_cast<unsigned int>(std::min<size_t>(size, 1 << 30)));
+#else
+            ssize_t written = ::write(fd, data, size);
+#endif
+            if (written < 0)
+            {
+                if (errno == EINTR)
+                {
+                    continue;
+                }
+                throw std::runtime_error(std::string("Failed to write output: ") + std::strerror(errno));
+            }
+            data += written;
+            size -= static_cast<size_t>(written);
+        }
+    }
+    void OutputSink::flush()
+    {
+        size_t pending = used;
+        used = 0;
+        write_all(buffer.data(), pending);
+    }
+    char *OutputSink::reserve(const size_t size)
+    {
+        if (used + size > buffer.size())
+        {
+            flush();
+            if (size > buffer.size())
+            {
+                buffer.resize(size);
+            }
+        }
+        return buffer.data() + used;
+    }
+    void OutputSink::commit(char *end)
+    {
+        used = static_cast<size_t>(end - buffer.data());
+    }
+    void OutputSink::append(const char *text, const size_t size)
+    {
+        if (size >= buffer.size())
+        {
+            flush();
+            write_all(text, size);
+            return;
+        }
+        char *output = reserve(size);
+        std::memcpy(output, text, size);
+        commit(output + size);
+    }
+    void OutputSink::append(const std::string &text)
+    {
+        append(text.data(), text.size());
+    }
+    void OutputSink::append(const char character)
+    {
+        char *output = reserve(1);
+        *output = character;
+        commit(output + 1);
+    }
+    void OutputSink::append_number(const double value)
+    {
+        char *output = reserve(max_number_length);
+        char *end = write_fixed(output, value);
+        commit(end != nullptr ? end : std::to_chars(output, output + max_number_length, value).ptr);
+    }
+    void OutputSink::append_number(const int64_t value)
+    {
+        char *output = reserve(max_number_length);
+        commit(std::to_chars(output, output + max_number_length, value).ptr);
+    }
+    void OutputSink::append_date(const std::time_t &time)
+    {
+        char *output = reserve(10);
+        commit(dates.format(time, output));
+    }
+    void CsvSink::write(const data::YahooStockData &data)
+    {
+        if (last != Kind::Prices)
+        {
+            append(std::string("Symbol,Date,Open,High,Low,Close,Adj Close,Volume\n"));
+            last = Kind::Prices;
+        }
+        for (size_t i = 0; i < data.date.size(); i++)
+        {
+            append(data.symbol);
+            append(',');
+            append_date(data.date[i]);
+            for (const std::vector<double> *column : {&data.open, &data.high, &data.low, &data.close, &data.adj_close, &data.volume})
+            {
+                append(',');
+                append_number((*column)[i]);
+            }
+            append('\n');
+        }
+    }
+    void CsvSink::write(const std::vector<optimization::OptimizationResult> &results)
+    {
+        if (last != Kind::Portfolios)
+        {
+            append(std::string("Portfolio,Expected Return,Volatility,Leverage,Sharpe Ratio,Ticker,Weight,Covariance Contribution\n"));
+            last = Kind::Portfolios;
+        }
+        for (const optimization::OptimizationResult &result : results)
+        {
+            int64_t index = static_cast<int64_t>(portfolios_written++);
+            for (const auto &[ticker, weight] : result.weights)
+            {
+                append_number(index);
+                for (double value : {result.expected_return, result.volatility, result.leverage, result.sharpe_ratio})
+                {
+                    append(',');
+                    append_number(value);
+                }
+                append(',');
+                append(ticker);
+                append(',');
+                append_number(weight);
+                append(',');
+                auto contribution = result.covariance_contributions.find(ticker);
+                if (contribution != result.covariance_contributions.end())
+                {
+                    append_number(contribution->second);
+                }
+                append('\n');
+            }
+        }
+    }
+    void JsonLinesSink::append_json_number(const double value)
+    {
+        if (std::isfinite(value))
+        {
+            append_number(value);
+        }
+        else
+        {
+            append("null", 4);
+        }
+    }
+    void JsonLinesSink::append_json_string(const std::string &text)
+    {
+        append('"');
+        for (char character : text)
+        {
+            if (character == '"' || character == '\\')
+            {
+                append('\\');
+                append(character);
+            }
+            else if (static_cast<unsigned char>(character) < 0x20)
+            {
+                static const char hex[] = "0123456789abcdef";
+                char escaped[6] = {'\\', 'u', '0', '0', hex[(character >> 4) & 0xf], hex[character & 0xf]};
+                append(escaped, sizeof(escaped));
+            }
+            else
+            {
+                append(character);
+            }
+        }
+        append('"');
+    }
+    void JsonLinesSink::write(const data::YahooStockData &data)
+    {
+        static const char *const names[] = {",\"open\":", ",\"high\":", ",\"low\":", ",\"close\":", ",\"adj_close\":", ",\"volume\":"};
+        const std::vector<double> *columns[] = {&data.open, &data.high, &data.low, &data.close, &data.adj_close, &data.volume};
+        for (size_t i = 0; i < data.date.size(); i++)
+        {
+            append("{\"symbol\":", 10);
+            append_json_string(data.symbol);
+            append(",\"date\":\"", 9);
+            append_date(data.date[i]);
+            append('"');
+            for (size_t c = 0; c < 6; c++)
+            {
+                append(names[c], std::strlen(names[c]));
+                append_json_number((*columns[c])[i]);
+            }
+            append("}\n", 2);
+        }
+    }
+    void JsonLinesSink::write(const std::vector<optimization::OptimizationResult> &results)
+    {
+        for (const optimization::OptimizationResult &result : results)
+        {
+            append(std::string("{\"portfolio\":"));
+            append_number(static_cast<int64_t>(portfolios_written++));
+            append(std::string(",\"expected_return\":"));
+            append_json_number(result.expected_return);
+            append(std::string(",\"volatility\":"));
+            append_json_number(result.volatility);
+            append(std::string(",\"leverage\":"));
+            append_json_number(result.leverage);
+            append(std::string(",\"sharpe_ratio\":"));
+            append_json_number(result.sharpe_ratio);
+            for (const auto *map : {&result.weights, &result.covariance_contributions})
+            {
+                append(std::string(map == &result.weights ? ",\"weights\":{" : ",\"covariance_contributions\":{"));
+                bool first = true;
+                for (const auto &[ticker, value] : *map)
+                {
+                    if (!first)
+                    {
+                        append(',');
+                    }
+                    first = false;
+                    append_json_string(ticker);
+                    append(':');
+                    append_json_number(value);
+                }
+                append('}');
+            }
+            append(std::string(",\"lagrange_multipliers\":["));
+            for (size_t i = 0; i < result.lagrange_multipliers.size(); i++)
+            {
+                if (i > 0)
+                {
+                    append(',');
+                }
+                append_json_number(result.lagrange_multipliers[i]);
+            }
+            append("]}\n", 3);
+        }
+    }
+    void BinarySink::append_string(const std::string &text)
+    {
+        append_value(static_cast<uint32_t>(text.size()));
+        append(text);
+    }
+    void BinarySink::write(const data::YahooStockData &data)
+    {
+        append_value(static_cast<uint8_t>(1));
+        append_string(data.symbol);
+        append_value(static_cast<uint64_t>(data.date.size()));
+        for (size_t i = 0; i < data.date.size(); i++)
+        {
+            append_value(static_cast<int64_t>(data.date[i]));
+            append_value(data.open[i]);
+            append_value(data.high[i]);
+            append_value(data.low[i]);
+            append_value(data.close[i]);
+            append_value(data.adj_close[i]);
+            append_value(data.volume[i]);
+        }
+    }
+    void BinarySink::write(const std::vector<optimization::OptimizationResult> &results)
+    {
+        for (const optimization::OptimizationResult &result : results)
+        {
+            append_value(static_cast<uint8_t>(2));
+            append_value(static_cast<uint64_t>(portfolios_written++));
+            append_value(result.expected_return);
+            append_value(result.volatility);
+            append_value(result.leverage);
+            append_value(result.sharpe_ratio);
+            append_value(static_cast<uint64_t>(result.weights.size()));
+            for (const auto &[ticker, weight] : result.weights)
+            {
+                auto contribution = result.covariance_contributions.find(ticker);
+                append_string(ticker);
+                append_value(weight);
+                append_value(contribution == result.covariance_contributions.end() ? std::nan("") : contribution->second);
+            }
+            append_value(static_cast<uint64_t>(result.lagrange_multipliers.size()));
+            for (double multiplier : result.lagrange_multipliers)
+            {
+                append_value(multiplier);
+            }
+        }
+    }
+    std::unique_ptr<OutputSink> make_sink(const Format format, const std::string &path)
+    {
+        switch (format)
+        {
+        case Format::Csv:
+            return std::make_unique<CsvSink>(path);
+        case Format::JsonLines:
+            return std::make_unique<JsonLinesSink>(path);
+        case Format::Binary:
+            return std::make_unique<BinarySink>(path);
+        }
+        throw std::invalid_argument("Unknown output format");
+    }
+    std::unique_ptr<OutputSink> make_sink(const Format format, const int fd)
+    {
+        switch (format)
+        {
+        case Format::Csv:
+            return std::make_unique<CsvSink>(fd);
+        case Format::JsonLines:
+            return std::make_unique<JsonLinesSink>(fd);
+        case Format::Binary:
+            return std::make_unique<BinarySink>(fd);
+        }
+        throw std::invalid_argument("Unknown output format");
+    }
+}
@@ -0,0 +1,116 @@
+#pragma once
+#include "../data/download_data.hpp"
+#include "../optimization/optimization.hpp"
+#include <vector>
+#include <string>
+#include <memory>
+#include <cstdint>
+#include <ctime>
+namespace portfolio_optimizer::output
+{
+    enum class Format
+    {
+        Csv,
+        JsonLines,
+        Binary
+    };
+    // Formats dates as YYYY-MM-DD in local time. The UTC offset is looked up for a span of dates it
+    // holds over instead of calling localtime for every row.
+    class DateFormatter
+    {
+    public:
+        // Writes exactly 10 characters
+        char *format(const std::time_t &time, char *output);
+
+    private:
+        std::time_t valid_from = 1;
+        std::time_t valid_until = 0;
+        int64_t offset = 0;
+    };
+    // Formats records into a reusable buffer and hands it to the file descriptor in large blocks.
+    // The descriptor is closed on destruction only when the sink opened it.
+    class OutputSink
+    {
+    public:
+        OutputSink(const int fd, const size_t buffer_size = 1 << 20);
+        OutputSink(const std::string &path, const size_t buffer_size = 1 << 20);
+        OutputSink(const OutputSink &) = delete;
+        OutputSink &operator=(const OutputSink &) = delete;
+        virtual ~OutputSink();
+        virtual void write(const data::YahooStockData &data) = 0;
+        virtual void write(const std::vector<optimization::OptimizationResult> &results) = 0;
+        void flush();
+
+    protected:
+        // Longest text std::to_chars produces for a double or a 64-bit integer
+        static constexpr size_t max_number_length = 32;
+        // Makes room for size bytes, flushing first when the buffer is too full
+        char *reserve(const size_t size);
+        void commit(char *end);
+        void append(const char *text, const size_t size);
+        void append(const std::string &text);
+        void append(const char character);
+        void append_number(const double value);
+        void append_number(const int64_t value);
+        void append_date(const std::time_t &time);
+        size_t portfolios_written = 0;
+
+    private:
+        int fd;
+        bool owned;
+        std::vector<char> buffer;
+        size_t used = 0;
+        DateFormatter dates;
+        void write_all(const char *data, size_t size);
+    };
+    // One header line per record kind, then one row per price row or per portfolio weight
+    class CsvSink : public OutputSink
+    {
+    public:
+        using OutputSink::OutputSink;
+        void write(const data::YahooStockData &data) override;
+        void write(const std::vector<optimization::OptimizationResult> &results) override;
+
+    private:
+        enum class Kind
+        {
+            None,
+            Prices,
+            Portfolios
+        };
+        Kind last = Kind::None;
+    };
+    // One JSON object per price row or per portfolio, NaN is written as null
+    class JsonLinesSink : public OutputSink
+    {
+    public:
+        using OutputSink::OutputSink;
+        void write(const data::YahooStockData &data) override;
+        void write(const std::vector<optimization::OptimizationResult> &results) override;
+
+    private:
+        void append_json_number(const double value);
+        void append_json_string(const std::string &text);
+    };
+    // Native-endian records, strings are a uint32 length followed by their bytes:
+    //   prices:    uint8 1, symbol, uint64 rows, rows x {int64 date, open, high, low, close, adj close, volume}
+    //   portfolio: uint8 2, uint64 index, expected return, volatility, leverage, sharpe ratio,
+    //              uint64 tickers, tickers x {ticker, weight, covariance contribution}, uint64 multipliers, multipliers
+    class BinarySink : public OutputSink
+    {
+    public:
+        using OutputSink::OutputSink;
+        void write(const data::YahooStockData &data) override;
+        void write(const std::vector<optimization::OptimizationResult> &results) override;
+
+    private:
+        template <typename T>
+        void append_value(const T value)
+        {
+            append(reinterpret_cast<const char *>(&value), sizeof(T));
+        }
+        void append_string(const std::string &text);
+    };
+    std::unique_ptr<OutputSink> make_sink(const Format format, const std::string &path);
+    std::unique_ptr<OutputSink> make_sink(const Format format, const int fd);
+}
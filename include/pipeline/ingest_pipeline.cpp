@@ -0,0 +1,253 @@
+#include "ingest_pipeline.hpp"
+#include "../optimization/linear_algebra.hpp"
+#include <cmath>
+#include <deque>
+#include <mutex>
+#include <chrono>
+#include <future>
+#include <limits>
+#include <algorithm>
+#include <stdexcept>
+#include <condition_variable>
+namespace portfolio_optimizer::pipeline
+{
+    namespace
+    {
+        // Monday to Friday are numbered consecutively, 1970-01-01 was a Thursday
+        int64_t business_day(const std::time_t &time)
+        {
+            int64_t days = data::local_day(time) + 3;
+            int64_t week = days >= 0 ? days / 7 : (days - 6) / 7;
+            return week * 5 + std::min<int64_t>(days - week * 7, 4);
+        }
+        struct Arrival
+        {
+            size_t index;
+            data::YahooStockData data;
+        };
+    }
+    IngestPipeline::IngestPipeline(data::DataSource &source, const PipelineOptions &options) : source(source), options(options)
+    {
+    }
+    PipelineResult IngestPipeline::run(const std::vector<std::string> &symbols, const std::time_t &start, const std::time_t &end)
+    {
+        if (start > end)
+        {
+            throw std::invalid_argument("Start must not be after end.");
+        }
+        const size_t assets = symbols.size();
+        const int64_t first_day = business_day(start);
+        const size_t days = static_cast<size_t>(business_day(end) - first_day + 1);
+        // Return t runs from day t to day t + 1
+        const size_t periods = days - 1;
+        auto started = std::chrono::steady_clock::now();
+        auto elapsed = [&]()
+        {
+            return std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+        };
+
+        std::mutex mutex;
+        std::condition_variable arrived;
+        std::deque<Arrival> queue;
+        bool done = false;
+        std::future<void> producer = std::async(std::launch::async, [&]()
+        {
+            try
+            {
+                source.stream(symbols, start, end, [&](size_t index, data::YahooStockData &data)
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    queue.push_back({index, std::move(data)});
+                    arrived.notify_one();
+                }, options.threads);
+            }
+            catch (...)
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                done = true;
+                arrived.notify_one();
+                throw;
+            }
+            std::lock_guard<std::mutex> lock(mutex);
+            done = true;
+            arrived.notify_one();
+        });
+
+        PipelineResult result;
+        result.symbols = symbols;
+        result.first_arrival = 0;
+        result.last_arrival = 0;
+        std::vector<double> columns(assets * periods);
+        // Returns less the symbol's shift from its first price on and 0 before it, so the cross-products of nearly
+        // constant columns keep their precision and back-filled days stay out of every sum
+        std::vector<double> deviations(assets * periods);
+        std::vector<double> shifts(assets, 0.0);
+        // First day with a price of every symbol, its returns start there
+        std::vector<size_t> listed(assets, 0);
+        std::vector<double> log_totals(assets, 0.0);
+        optimization::SymmetricMatrix<double> cross_products(assets);
+        // (i, j) sums the deviations of i over the periods both i and j are listed
+        optimization::Matrix<double> overlap_sums(assets, assets);
+        std::vector<size_t> received;
+        received.reserve(assets);
+        std::vector<bool> traded(days, false);
+        std::vector<std::time_t> day_dates(days, 0);
+        std::vector<double> prices(days);
+        while (received.size() < assets)
+        {
+            Arrival arrival;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                arrived.wait(lock, [&]() { return !queue.empty() || done; });
+                if (queue.empty())
+                {
+                    break;
+                }
+                arrival = std::move(queue.front());
+                queue.pop_front();
+            }
+            if (received.empty())
+            {
+                result.first_arrival = elapsed();
+            }
+            const size_t k = arrival.index;
+            const std::vector<double> &series = arrival.data.column(options.column);
+            std::fill(prices.begin(), prices.end(), std::numeric_limits<double>::quiet_NaN());
+            for (size_t i = 0; i < series.size(); i++)
+            {
+                int64_t day = business_day(arrival.data.date[i]) - first_day;
+                if (day < 0 || day >= static_cast<int64_t>(days) || std::isnan(series[i]))
+                {
+                    continue;
+                }
+                prices[day] = series[i];
+                traded[day] = true;
+                day_dates[day] = arrival.data.date[i];
+            }
+            auto first = std::find_if(prices.begin(), prices.end(), [](double price) { return !std::isnan(price); });
+            if (first == prices.end())
+            {
+                throw std::runtime_error(symbols[k] + " has no prices in range.");
+            }
+            std::fill(prices.begin(), first, *first);
+            for (auto price = first + 1; price != prices.end(); ++price)
+            {
+                if (std::isnan(*price))
+                {
+                    *price = *(price - 1);
+                }
+            }
+            double *column = columns.data() + k * periods;
+            if (periods > 0)
+            {
+                data::compute_returns(prices.data(), days, column, options.type, options.periods_per_year);
+            }
+            log_totals[k] = std::log(prices[days - 1] / prices[0]);
+            listed[k] = static_cast<size_t>(first - prices.begin());
+            double shift = 0;
+            for (size_t t = listed[k]; t < periods; t++)
+            {
+                shift += column[t];
+            }
+            shift = listed[k] < periods ? shift / static_cast<double>(periods - listed[k]) : 0;
+            shifts[k] = shift;
+            double *deviation = deviations.data() + k * periods;
+            for (size_t t = 0; t < periods; t++)
+            {
+                deviation[t] = t < listed[k] ? 0 : column[t] - shift;
+            }
+            received.push_back(k);
+            for (size_t j : received)
+            {
+                const size_t overlap = std::max(listed[k], listed[j]);
+                const double *other = deviations.data() + j * periods;
+                double sum = 0;
+                double other_sum = 0;
+                for (size_t t = overlap; t < periods; t++)
+                {
+                    sum += deviation[t];
+                    other_sum += other[t];
+                }
+                overlap_sums(k, j) = sum;
+                overlap_sums(j, k) = other_sum;
+                cross_products(k, j) = overlap < periods ? optimization::dot(deviation + overlap, other + overlap, periods - overlap) : 0;
+            }
+            result.last_arrival = elapsed();
+        }
+        producer.get();
+        if (received.size() < assets)
+        {
+            throw std::runtime_error("Not every symbol was received.");
+        }
+
+        // Rows of the returns matrix skip the days nobody traded, which hold zero returns for every symbol, and the
+        // first traded day, whose return starts from a back-filled price.
+        std::vector<size_t> kept;
+        size_t first_traded = std::find(traded.begin(), traded.end(), true) - traded.begin();
+        for (size_t t = first_traded; t < periods; t++)
+        {
+            if (traded[t + 1])
+            {
+                kept.push_back(t);
+            }
+        }
+        result.dates.resize(kept.size());
+        result.returns = optimization::Matrix<double>(kept.size(), assets);
+        for (size_t i = 0; i < kept.size(); i++)
+        {
+            result.dates[i] = day_dates[kept[i] + 1];
+            double *row = result.returns.values() + i * assets;
+            for (size_t k = 0; k < assets; k++)
+            {
+                row[k] = columns[k * periods + kept[i]];
+            }
+        }
+        // Periods from t on whose end day nobody traded. Every listed symbol holds a zero return there, a deviation of
+        // -shift, which is taken back out of its sums and cross-products.
+        std::vector<size_t> untraded(periods + 1, 0);
+        for (size_t t = periods; t-- > 0;)
+        {
+            untraded[t] = untraded[t + 1] + !traded[t + 1];
+        }
+        // Kept periods from t on
+        auto observed = [&](const size_t t)
+        {
+            return t < periods ? static_cast<double>(periods - t - untraded[t]) : 0.0;
+        };
+        result.covariance = optimization::SymmetricMatrix<double>(assets);
+        for (size_t i = 0; i < assets; i++)
+        {
+            const double *cross_row = cross_products.row(i);
+            double *row = result.covariance.row(i);
+            for (size_t j = 0; j <= i; j++)
+            {
+                // Over the periods both symbols are listed
+                const size_t overlap = std::max(listed[i], listed[j]);
+                const double pairs = observed(overlap);
+                const double dropped = static_cast<double>(untraded[std::min(overlap, periods)]);
+                const double sum_i = overlap_sums(i, j) + dropped * shifts[i];
+                const double sum_j = overlap_sums(j, i) + dropped * shifts[j];
+                const double cross = cross_row[j] - dropped * shifts[i] * shifts[j];
+                row[j] = pairs > 1 ? (cross - sum_i * sum_j / pairs) / (pairs - 1) * options.periods_per_year : 0;
+            }
+        }
+        result.moments.resize(assets);
+        result.expected_returns.resize(assets);
+        for (size_t k = 0; k < assets; k++)
+        {
+            // Every symbol counts its own observations, from its first price on
+            const double count = observed(listed[k]);
+            const double dropped = static_cast<double>(untraded[std::min(listed[k], periods)]);
+            data::ReturnMoments &moments = result.moments[k];
+            moments.mean = count > 0 ? shifts[k] + (overlap_sums(k, k) + dropped * shifts[k]) / count : 0;
+            moments.variance = result.covariance(k, k) / options.periods_per_year;
+            moments.log_mean = count > 0 ? log_totals[k] / count : 0;
+            moments.annualized_mean = moments.mean * options.periods_per_year;
+            moments.annualized_variance = result.covariance(k, k);
+            moments.annualized_log_mean = moments.log_mean * options.periods_per_year;
+            result.expected_returns[k] = std::exp(moments.annualized_log_mean) - 1;
+        }
+        result.finished = elapsed();
+        return result;
+    }
+}
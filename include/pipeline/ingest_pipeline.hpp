@@ -0,0 +1,53 @@
+#pragma once
+#include "../data/data_source.hpp"
+#include "../data/returns.hpp"
+#include "../optimization/matrix.hpp"
+#include "../optimization/symmetric_matrix.hpp"
+#include <vector>
+#include <string>
+#include <ctime>
+namespace portfolio_optimizer::pipeline
+{
+    struct PipelineOptions
+    {
+        data::YahooStockData::ReturnColumn column = data::YahooStockData::ReturnColumn::AdjClose;
+        data::ReturnType type = data::ReturnType::Simple;
+        double periods_per_year = 252;
+        // Passed on to DataSource::stream
+        size_t threads = 0;
+    };
+    typedef struct
+    {
+        std::vector<std::string> symbols;
+        // End date of every return period, only days at least one symbol traded are kept
+        std::vector<std::time_t> dates;
+        // periods x symbols
+        optimization::Matrix<double> returns;
+        std::vector<data::ReturnMoments> moments;
+        // exp(annualized_log_mean) - 1 of every symbol
+        std::vector<double> expected_returns;
+        // Annualised
+        optimization::SymmetricMatrix<double> covariance;
+        // Seconds from the start of run to the first and last arrival and to the finished result
+        double first_arrival;
+        double last_arrival;
+        double finished;
+    } PipelineResult;
+    // Overlaps ingest with compute: every symbol's return column is built and its cross-products against the
+    // columns already received are accumulated as soon as its data lands, so the covariance is complete right
+    // after the last arrival instead of after a separate pass over the whole panel.
+    // Columns live on a business day axis between start and end: prices are forward-filled over the days a
+    // symbol did not trade (and back-filled before its first price), weekend bars fold into Friday, and days
+    // nobody traded are dropped from the estimates. A symbol's moments only count the periods from its first price
+    // on and a covariance the periods both symbols have prices, so back-filled days do not bias a late listing.
+    class IngestPipeline
+    {
+    public:
+        IngestPipeline(data::DataSource &source, const PipelineOptions &options = PipelineOptions());
+        PipelineResult run(const std::vector<std::string> &symbols, const std::time_t &start, const std::time_t &end);
+
+    private:
+        data::DataSource &source;
+        PipelineOptions options;
+    };
+}
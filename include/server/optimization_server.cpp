@@ -0,0 +1,484 @@
+#include "optimization_server.hpp"
+#include "../data/data_source.hpp"
+#include "../data/returns.hpp"
+#include "../optimization/cholesky.hpp"
+#include "../optimization/linear_algebra.hpp"
+#include "../optimization/risk_parity.hpp"
+#include "../optimization/hierarchical_risk_parity.hpp"
+#include <cmath>
+#include <limits>
+#include <charconv>
+#include <sstream>
+#include <algorithm>
+#include <stdexcept>
+namespace portfolio_optimizer::server
+{
+    namespace
+    {
+        void append_number(std::string &output, double value)
+        {
+            char buffer[32];
+            auto [end, error] = std::to_chars(buffer, buffer + sizeof(buffer), value);
+            output.append(buffer, end);
+        }
+    }
+    OptimizationServer::OptimizationServer(const ServerOptions &options)
+    {
+        this->options = options;
+    }
+    size_t OptimizationServer::symbol_count() const
+    {
+        return series.size();
+    }
+    size_t OptimizationServer::observation_count() const
+    {
+        return observations;
+    }
+    size_t OptimizationServer::symbol_index(const std::string &symbol)
+    {
+        auto found = symbols.find(symbol);
+        if (found != symbols.end())
+        {
+            return found->second;
+        }
+        size_t index = series.size();
+        series.emplace_back();
+        series.back().symbol = symbol;
+        symbols[symbol] = index;
+        std::vector<double> zeros(index + 1, 0.0);
+        cross_products.append(zeros.data());
+        std::vector<size_t> none(index + 1, 0);
+        overlaps.append(none.data());
+        for (std::vector<double> &sums : overlap_sums)
+        {
+            sums.push_back(0.0);
+        }
+        overlap_sums.emplace_back(index + 1, 0.0);
+        return index;
+    }
+    size_t OptimizationServer::row_index(int64_t day)
+    {
+        auto [found, inserted] = rows.try_emplace(day, rows.size());
+        if (inserted)
+        {
+            row_symbols.push_back(0);
+        }
+        return found->second;
+    }
+    void OptimizationServer::pair_row(size_t index, size_t row, double value, int sign)
+    {
+        for (size_t j = 0; j < series.size(); j++)
+        {
+            if (j != index && row < series[j].defined.size() && series[j].defined[row])
+            {
+                overlaps(index, j) += sign;
+                overlap_sums[index][j] += sign * value;
+                overlap_sums[j][index] += sign * series[j].returns[row];
+            }
+        }
+    }
+    void OptimizationServer::set_defined(Series &entry, size_t row, bool defined)
+    {
+        if (static_cast<bool>(entry.defined[row]) == defined)
+        {
+            return;
+        }
+        entry.defined[row] = defined;
+        entry.count += defined ? 1 : -1;
+        if (defined)
+        {
+            observations += row_symbols[row]++ == 0;
+        }
+        else
+        {
+            observations -= --row_symbols[row] == 0;
+        }
+    }
+    void OptimizationServer::set_return(size_t index, size_t row, double value, bool defined)
+    {
+        Series &entry = series[index];
+        if (entry.returns.size() <= row)
+        {
+            entry.returns.resize(rows.size(), 0.0);
+            entry.defined.resize(rows.size(), 0);
+        }
+        double previous = entry.returns[row];
+        double delta = value - previous;
+        bool was_defined = entry.defined[row];
+        if (delta != 0)
+        {
+            // Only this symbol's row of cross-products moves
+            for (size_t j = 0; j < series.size(); j++)
+            {
+                if (j != index && row < series[j].returns.size() && series[j].returns[row] != 0)
+                {
+                    cross_products(index, j) += delta * series[j].returns[row];
+                }
+            }
+            cross_products(index, index) += value * value - previous * previous;
+            entry.sum += delta;
+            entry.returns[row] = value;
+        }
+        if (was_defined && (!defined || delta != 0))
+        {
+            pair_row(index, row, previous, -1);
+        }
+        if (defined && (!was_defined || delta != 0))
+        {
+            pair_row(index, row, value, 1);
+        }
+        set_defined(entry, row, defined);
+    }
+    void OptimizationServer::add_price(const std::string &symbol, const std::time_t &date, const double price)
+    {
+        if (!(price > 0))
+        {
+            throw std::invalid_argument("Prices must be positive.");
+        }
+        size_t index = symbol_index(symbol);
+        int64_t day = data::local_day(date);
+        std::map<int64_t, double> &prices = series[index].prices;
+        auto current = prices.insert_or_assign(day, price).first;
+        if (current == prices.begin())
+        {
+            set_return(index, row_index(day), 0, false);
+        }
+        else
+        {
+            set_return(index, row_index(day), price / std::prev(current)->second - 1, true);
+        }
+        auto next = std::next(current);
+        if (next != prices.end())
+        {
+            set_return(index, row_index(next->first), next->second / price - 1, true);
+        }
+        series[index].version++;
+    }
+    void OptimizationServer::set_prices(const data::YahooStockData &data, data::YahooStockData::ReturnColumn column)
+    {
+        size_t index = symbol_index(data.symbol);
+        const std::vector<double> &values = data.column(column);
+        std::map<int64_t, double> prices;
+        for (size_t i = 0; i < values.size(); i++)
+        {
+            if (values[i] > 0)
+            {
+                prices[data::local_day(data.date[i])] = values[i];
+            }
+        }
+        std::vector<size_t> defined_rows;
+        std::vector<double> returns;
+        double previous = 0;
+        for (const auto &[day, price] : prices)
+        {
+            size_t row = row_index(day);
+            if (previous > 0)
+            {
+                returns.resize(rows.size(), 0.0);
+                returns[row] = price / previous - 1;
+                defined_rows.push_back(row);
+            }
+            previous = price;
+        }
+        returns.resize(rows.size(), 0.0);
+        Series &entry = series[index];
+        for (size_t row = 0; row < entry.defined.size(); row++)
+        {
+            set_defined(entry, row, false);
+        }
+        entry.defined.assign(rows.size(), 0);
+        for (size_t row : defined_rows)
+        {
+            set_defined(entry, row, true);
+        }
+        entry.returns = std::move(returns);
+        entry.prices = std::move(prices);
+        entry.sum = 0;
+        for (double value : entry.returns)
+        {
+            entry.sum += value;
+        }
+        for (size_t j = 0; j < series.size(); j++)
+        {
+            const std::vector<double> &other = series[j].returns;
+            cross_products(index, j) = optimization::dot(entry.returns.data(), other.data(), std::min(entry.returns.size(), other.size()));
+            if (j == index)
+            {
+                continue;
+            }
+            const std::vector<char> &other_defined = series[j].defined;
+            size_t both = 0;
+            double own_sum = 0;
+            double other_sum = 0;
+            for (size_t row = 0; row < std::min(entry.defined.size(), other_defined.size()); row++)
+            {
+                if (entry.defined[row] && other_defined[row])
+                {
+                    both++;
+                    own_sum += entry.returns[row];
+                    other_sum += other[row];
+                }
+            }
+            overlaps(index, j) = both;
+            overlap_sums[index][j] = own_sum;
+            overlap_sums[j][index] = other_sum;
+        }
+        entry.version++;
+    }
+    OptimizationServer::Universe &OptimizationServer::universe(const std::vector<std::string> &requested)
+    {
+        std::vector<size_t> members;
+        if (requested.empty())
+        {
+            for (size_t i = 0; i < series.size(); i++)
+            {
+                members.push_back(i);
+            }
+        }
+        for (const std::string &symbol : requested)
+        {
+            auto found = symbols.find(symbol);
+            if (found == symbols.end())
+            {
+                throw std::invalid_argument("Unknown symbol " + symbol);
+            }
+            members.push_back(found->second);
+        }
+        std::sort(members.begin(), members.end());
+        members.erase(std::unique(members.begin(), members.end()), members.end());
+        if (members.empty())
+        {
+            throw std::invalid_argument("No symbols loaded.");
+        }
+        for (size_t member : members)
+        {
+            if (series[member].count < 2)
+            {
+                throw std::invalid_argument("Not enough observations for " + series[member].symbol);
+            }
+        }
+        std::string key;
+        for (size_t member : members)
+        {
+            key += std::to_string(member);
+            key += ',';
+        }
+        Universe &entry = universes[key];
+        entry.last_used = ++clock;
+        bool valid = entry.ready;
+        for (size_t i = 0; valid && i < members.size(); i++)
+        {
+            valid = entry.versions[i] == series[members[i]].version;
+        }
+        if (valid)
+        {
+            cache_hits++;
+            return entry;
+        }
+        cache_misses++;
+        const size_t k = members.size();
+        entry.members = members;
+        entry.versions.resize(k);
+        entry.covariance = optimization::SymmetricMatrix<double>(k);
+        entry.expected_returns.resize(k);
+        for (size_t i = 0; i < k; i++)
+        {
+            const Series &member = series[members[i]];
+            const double count = static_cast<double>(member.count);
+            entry.versions[i] = member.version;
+            double log_total = std::log(member.prices.rbegin()->second / member.prices.begin()->second);
+            entry.expected_returns[i] = std::exp(log_total / count * options.periods_per_year) - 1;
+            entry.covariance(i, i) = (cross_products(members[i], members[i]) - member.sum * member.sum / count) / (count - 1) * options.periods_per_year;
+        }
+        // Pairwise over the rows both have a return on, pairs with fewer than two of them are taken as uncorrelated
+        for (size_t i = 0; i < k; i++)
+        {
+            for (size_t j = 0; j < i; j++)
+            {
+                const double both = static_cast<double>(overlaps(members[i], members[j]));
+                entry.covariance(i, j) = both < 2 ? 0 : (cross_products(members[i], members[j]) - overlap_sums[members[i]][members[j]] * overlap_sums[members[j]][members[i]] / both) / (both - 1) * options.periods_per_year;
+            }
+        }
+        entry.frontier.reset();
+        entry.hierarchical_weights.clear();
+        entry.risk_parity_current = false;
+        entry.ready = true;
+        if (universes.size() > options.max_cached_universes)
+        {
+            auto oldest = universes.end();
+            for (auto it = universes.begin(); it != universes.end(); ++it)
+            {
+                if (&it->second != &entry && (oldest == universes.end() || it->second.last_used < oldest->second.last_used))
+                {
+                    oldest = it;
+                }
+            }
+            if (oldest != universes.end())
+            {
+                universes.erase(oldest);
+            }
+        }
+        return entry;
+    }
+    std::string OptimizationServer::reply(const Universe &universe, const std::vector<double> &weights, double variance)
+    {
+        double expected_return = 0;
+        for (size_t i = 0; i < weights.size(); i++)
+        {
+            expected_return += weights[i] * universe.expected_returns[i];
+        }
+        double volatility = std::sqrt(std::max(0.0, variance));
+        std::string output = "ok return=";
+        append_number(output, expected_return);
+        output += " volatility=";
+        append_number(output, volatility);
+        output += " sharpe=";
+        append_number(output, (expected_return - options.risk_free_rate) / volatility);
+        for (size_t i = 0; i < weights.size(); i++)
+        {
+            output += ' ';
+            output += series[universe.members[i]].symbol;
+            output += '=';
+            append_number(output, weights[i]);
+        }
+        return output;
+    }
+    std::string OptimizationServer::handle(const std::string &line)
+    {
+        std::istringstream input(line);
+        std::string command;
+        input >> command;
+        try
+        {
+            std::vector<std::string> arguments;
+            std::string argument;
+            while (input >> argument)
+            {
+                arguments.push_back(argument);
+            }
+            if (command == "add")
+            {
+                if (arguments.size() != 3)
+                {
+                    throw std::invalid_argument("Usage: add SYMBOL YYYY-MM-DD PRICE");
+                }
+                add_price(arguments[0], data::date_util.to_time_t(arguments[1]), std::stod(arguments[2]));
+                return "ok";
+            }
+            if (command == "load" || command == "download")
+            {
+                if (arguments.empty())
+                {
+                    throw std::invalid_argument("Usage: load DIRECTORY [SYMBOL...] or download SYMBOL...");
+                }
+                std::vector<data::YahooStockData> loaded;
+                if (command == "load")
+                {
+                    data::CsvDirectoryDataSource source(arguments[0]);
+                    std::vector<std::string> requested(arguments.begin() + 1, arguments.end());
+                    loaded = source.load(requested.empty() ? source.symbols() : requested, std::numeric_limits<std::time_t>::min(),
+                                         std::numeric_limits<std::time_t>::max(), options.threads);
+                }
+                else
+                {
+                    loaded = data::YahooDataSource().load(arguments, data::date_util.add_time(data::date_util.now(), -4), data::date_util.now());
+                }
+                for (const data::YahooStockData &history : loaded)
+                {
+                    set_prices(history);
+                }
+                return "ok loaded=" + std::to_string(loaded.size());
+            }
+            if (command == "frontier" || command == "minvar")
+            {
+                double target = 0;
+                if (command == "frontier")
+                {
+                    if (arguments.empty())
+                    {
+                        throw std::invalid_argument("Usage: frontier TARGET [SYMBOL...]");
+                    }
+                    target = std::stod(arguments[0]);
+                    arguments.erase(arguments.begin());
+                }
+                Universe &entry = universe(arguments);
+                if (!entry.frontier)
+                {
+                    optimization::Cholesky<double> factor;
+                    try
+                    {
+                        factor.factor(entry.covariance, options.threads);
+                    }
+                    catch (const std::invalid_argument &)
+                    {
+                        // Pairwise covariances of symbols with different histories need not form a valid matrix
+                        throw std::invalid_argument("Covariance not positive definite for this universe, its symbols share too few observations.");
+                    }
+                    entry.frontier.emplace(factor, entry.expected_returns);
+                }
+                if (command == "minvar")
+                {
+                    target = entry.frontier->minimum_variance_return();
+                }
+                return reply(entry, entry.frontier->weights(target), entry.frontier->variance(target));
+            }
+            if (command == "riskparity")
+            {
+                Universe &entry = universe(arguments);
+                if (!entry.risk_parity_current)
+                {
+                    std::vector<double> budgets(entry.members.size(), 1.0);
+                    std::vector<double> initial = entry.risk_parity_weights.size() == budgets.size() ? entry.risk_parity_weights : std::vector<double>();
+                    optimization::RiskParityResult solution = optimization::risk_budgeting(entry.covariance, budgets, optimization::RiskParityOptions(), initial);
+                    entry.risk_parity_weights = solution.weights;
+                    entry.risk_parity_variance = solution.volatility * solution.volatility;
+                    entry.risk_parity_current = true;
+                }
+                return reply(entry, entry.risk_parity_weights, entry.risk_parity_variance);
+            }
+            if (command == "hrp")
+            {
+                Universe &entry = universe(arguments);
+                if (entry.hierarchical_weights.empty())
+                {
+                    entry.hierarchical_weights = optimization::hierarchical_risk_parity(entry.covariance, options.threads).weights;
+                    entry.hierarchical_variance = entry.covariance.quadratic_form(entry.hierarchical_weights);
+                }
+                return reply(entry, entry.hierarchical_weights, entry.hierarchical_variance);
+            }
+            if (command == "stats")
+            {
+                return "ok symbols=" + std::to_string(series.size()) + " rows=" + std::to_string(rows.size()) +
+                       " observations=" + std::to_string(observations) + " universes=" + std::to_string(universes.size()) +
+                       " hits=" + std::to_string(cache_hits) + " misses=" + std::to_string(cache_misses);
+            }
+            if (command == "quit")
+            {
+                return "ok";
+            }
+            throw std::invalid_argument("Unknown command " + command);
+        }
+        catch (const std::exception &e)
+        {
+            return std::string("error ") + e.what();
+        }
+    }
+    void OptimizationServer::serve(std::istream &input, std::ostream &output)
+    {
+        std::string line;
+        while (std::getline(input, line))
+        {
+            if (line.empty())
+            {
+                continue;
+            }
+            output << handle(line) << std::endl;
+            std::string command;
+            std::istringstream(line) >> command;
+            if (command == "quit")
+            {
+                break;
+            }
+        }
+    }
+}
@@ -0,0 +1,102 @@
+#pragma once
+#include "../data/download_data.hpp"
+#include "../optimization/matrix.hpp"
+#include "../optimization/symmetric_matrix.hpp"
+#include "../optimization/frontier.hpp"
+#include <map>
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <optional>
+#include <unordered_map>
+namespace portfolio_optimizer::server
+{
+    struct ServerOptions
+    {
+        double periods_per_year = 252;
+        double risk_free_rate = 0;
+        // Least recently used universes are dropped past this many
+        size_t max_cached_universes = 64;
+        // Used by hrp and the bulk loaders, 0 uses every hardware thread
+        size_t threads = 0;
+    };
+    // Keeps prices, returns and their cross-products resident and answers one request per line:
+    //   add SYMBOL YYYY-MM-DD PRICE        load DIRECTORY [SYMBOL...]       download SYMBOL...
+    //   frontier TARGET [SYMBOL...]        minvar [SYMBOL...]               riskparity [SYMBOL...]
+    //   hrp [SYMBOL...]                    stats                            quit
+    // An empty symbol list means every known symbol. Every reply is one line starting with "ok" or "error".
+    // A new price only touches its symbol's row of cross-products, O(N), and a universe's covariance and
+    // factorization are reused until one of its members changes. Symbols may cover different dates: means use each
+    // symbol's own returns and covariances the dates both symbols have a return on.
+    class OptimizationServer
+    {
+    public:
+        OptimizationServer(const ServerOptions &options = ServerOptions());
+        std::string handle(const std::string &line);
+        // Answers requests until quit or the end of input
+        void serve(std::istream &input, std::ostream &output);
+        void add_price(const std::string &symbol, const std::time_t &date, const double price);
+        // Replaces the whole history of data.symbol with the given column
+        void set_prices(const data::YahooStockData &data, data::YahooStockData::ReturnColumn column = data::YahooStockData::ReturnColumn::AdjClose);
+        size_t symbol_count() const;
+        size_t observation_count() const;
+
+    private:
+        struct Series
+        {
+            std::string symbol;
+            // Keyed by local day, see data::local_day
+            std::map<int64_t, double> prices;
+            // Indexed by row, a return is defined on every price day but the first
+            std::vector<double> returns;
+            std::vector<char> defined;
+            double sum = 0;
+            // Defined returns
+            size_t count = 0;
+            uint64_t version = 0;
+        };
+        struct Universe
+        {
+            std::vector<size_t> members;
+            std::vector<uint64_t> versions;
+            bool ready = false;
+            optimization::SymmetricMatrix<double> covariance;
+            std::vector<double> expected_returns;
+            std::optional<optimization::FrontierSolution> frontier;
+            std::vector<double> hierarchical_weights;
+            double hierarchical_variance = 0;
+            // Kept when the universe goes stale, it warm-starts the next solve
+            std::vector<double> risk_parity_weights;
+            double risk_parity_variance = 0;
+            bool risk_parity_current = false;
+            uint64_t last_used = 0;
+        };
+        ServerOptions options;
+        std::vector<Series> series;
+        std::unordered_map<std::string, size_t> symbols;
+        // Rows are numbered in order of first appearance, sums of products do not depend on their order
+        std::unordered_map<int64_t, size_t> rows;
+        std::vector<size_t> row_symbols;
+        size_t observations = 0;
+        // Grows by one packed row per new symbol
+        optimization::SymmetricMatrix<double> cross_products;
+        // Rows on which both symbols have a return, the diagonal is unused
+        optimization::SymmetricMatrix<size_t> overlaps;
+        // overlap_sums[i][j] sums the returns of i on the rows where j has a return
+        std::vector<std::vector<double>> overlap_sums;
+        std::unordered_map<std::string, Universe> universes;
+        uint64_t clock = 0;
+        size_t cache_hits = 0;
+        size_t cache_misses = 0;
+        size_t symbol_index(const std::string &symbol);
+        size_t row_index(int64_t day);
+        // Adds (sign 1) or removes (sign -1) the pairs formed by return value of index on row with the other symbols' returns
+        void pair_row(size_t index, size_t row, double value, int sign);
+        void set_defined(Series &entry, size_t row, bool defined);
+        void set_return(size_t index, size_t row, double value, bool defined);
+        Universe &universe(const std::vector<std::string> &requested);
+        std::string reply(const Universe &universe, const std::vector<double> &weights, double variance);
+    };
+}
@@ -0,0 +1,257 @@
+#include "../include/data/download_data.hpp"
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include <iostream>
+#include <algorithm>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+using namespace portfolio_optimizer::data;
+namespace
+{
+    size_t failures = 0;
+    void check(const bool condition, const std::string &message)
+    {
+        if (!condition)
+        {
+            std::cerr << "FAILED: " << message << "\n";
+            failures++;
+        }
+    }
+    long query(const std::string &target, const std::string &name)
+    {
+        const size_t found = target.find(name + "=");
+        return found == std::string::npos ? 0 : std::atol(target.c_str() + found + name.size() + 1);
+    }
+    // Answers the download endpoint on the loopback interface with one bar per interval of [period1, period2],
+    // both ends included, like Yahoo does. Volume holds the bar's timestamp so tests can check the stitching.
+    // Symbol FAIL answers 500 for the chunk starting at fail_period, THROTTLED answers 429 with Retry-After.
+    class FakeYahoo
+    {
+    private:
+        int listener = -1;
+        int port = 0;
+        std::thread acceptor;
+        std::vector<std::thread> connections;
+        std::mutex mutex;
+
+        static std::string response(const std::string &target)
+        {
+            const std::string symbol = target.substr(target.rfind('/') + 1, target.find('?') - target.rfind('/') - 1);
+            const long period1 = query(target, "period1");
+            const long period2 = query(target, "period2");
+            if (symbol == "THROTTLED")
+            {
+                return "HTTP/1.1 429 Too Many Requests\r\nRetry-After: 7\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+            }
+            if (symbol == "FAIL" && period1 == fail_period)
+            {
+                return "HTTP/1.1 500 Internal Server Error\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+            }
+            const std::string interval = target.substr(target.find("interval=") + 9, 2);
+            const long step = interval == "1h" ? 3600 : 86400;
+            std::string body = "Date,Open,High,Low,Close,Adj Close,Volume\n";
+            char date[64];
+            for (long t = (period1 + step - 1) / step * step; t <= period2; t += step)
+            {
+                std::time_t time = t;
+                std::tm parts;
+                gmtime_r(&time, &parts);
+                if (step < 86400)
+                {
+                    // Session bars 14:30 to 21:00 UTC on weekdays
+                    if (parts.tm_wday == 0 || parts.tm_wday == 6 || t % 86400 < 52200 || t % 86400 >= 75600)
+                    {
+                        continue;
+                    }
+                    std::strftime(date, sizeof(date), "%Y-%m-%d %H:%M:%S+00:00", &parts);
+                }
+                else
+                {
+                    std::strftime(date, sizeof(date), "%Y-%m-%d", &parts);
+                }
+                body += std::string(date) + ",1,2,0.5,1.5,1.5," + std::to_string(t) + "\n";
+            }
+            return "HTTP/1.1 200 OK\r\nContent-Type: text/csv\r\nContent-Length: " + std::to_string(body.size()) + "\r\nConnection: close\r\n\r\n" + body;
+        }
+        static void serve(const int connection, const unsigned int delay_ms)
+        {
+            std::string request;
+            char buffer[4096];
+            while (request.find("\r\n\r\n") == std::string::npos)
+            {
+                const ssize_t received = recv(connection, buffer, sizeof(buffer), 0);
+                if (received <= 0)
+                {
+                    close(connection);
+                    return;
+                }
+                request.append(buffer, static_cast<size_t>(received));
+            }
+            // Chunks finish out of order
+            std::this_thread::sleep_for(std::chrono::milliseconds(delay_ms));
+            const size_t target_start = request.find(' ') + 1;
+            const std::string reply = response(request.substr(target_start, request.find(' ', target_start) - target_start));
+            for (size_t sent = 0; sent < reply.size();)
+            {
+                const ssize_t written = send(connection, reply.data() + sent, reply.size() - sent, MSG_NOSIGNAL);
+                if (written <= 0)
+                {
+                    break;
+                }
+                sent += static_cast<size_t>(written);
+            }
+            close(connection);
+        }
+
+    public:
+        static inline std::atomic<long> fail_period{-1};
+        std::atomic<size_t> requests{0};
+
+        FakeYahoo()
+        {
+            listener = socket(AF_INET, SOCK_STREAM, 0);
+            sockaddr_in address{};
+            address.sin_family = AF_INET;
+            address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+            address.sin_port = 0;
+            socklen_t length = sizeof(address);
+            if (listener < 0 || bind(listener, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0 || listen(listener, 64) != 0 ||
+                getsockname(listener, reinterpret_cast<sockaddr *>(&address), &length) != 0)
+            {
+                throw std::runtime_error("Failed to listen on the loopback interface");
+            }
+            port = ntohs(address.sin_port);
+            acceptor = std::thread([this]()
+            {
+                unsigned int delay = 0;
+                while (true)
+                {
+                    const int connection = accept(listener, nullptr, nullptr);
+                    if (connection < 0)
+                    {
+                        return;
+                    }
+                    requests++;
+                    delay = (delay + 7) % 23;
+                    std::lock_guard<std::mutex> lock(mutex);
+                    connections.emplace_back(serve, connection, delay);
+                }
+            });
+        }
+        ~FakeYahoo()
+        {
+            shutdown(listener, SHUT_RDWR);
+            close(listener);
+            acceptor.join();
+            for (std::thread &connection : connections)
+            {
+                connection.join();
+            }
+        }
+        std::string host() const
+        {
+            return "http://127.0.0.1:" + std::to_string(port);
+        }
+    };
+    bool same_bars(const YahooStockData &a, const YahooStockData &b)
+    {
+        return a.date == b.date && a.open == b.open && a.high == b.high && a.low == b.low && a.close == b.close &&
+               a.adj_close == b.adj_close && a.volume == b.volume;
+    }
+    // Bars are strictly increasing, so a boundary bar returned by two chunks is kept once, and are stamped as served
+    bool stitched(const YahooStockData &data)
+    {
+        for (size_t i = 0; i < data.date.size(); i++)
+        {
+            if ((i > 0 && data.date[i] <= data.date[i - 1]) || data.volume[i] != static_cast<double>(data.date[i]))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+    // A chunked download matches one request for the whole range
+    void chunked_matches_whole(FakeYahoo &server, const BarInterval interval, const std::time_t start, const std::time_t end, const std::time_t chunk_seconds)
+    {
+        DownloadOptions options;
+        options.host = server.host();
+        options.interval = interval;
+        options.chunk_seconds = end - start;
+        const size_t before = server.requests;
+        YahooStockData whole = download_yahoo_data("TEST", start, end, options);
+        check(server.requests - before == 1, "a range within chunk_seconds is one request");
+        options.chunk_seconds = chunk_seconds;
+        const size_t chunks = static_cast<size_t>((end - start + chunk_seconds - 1) / chunk_seconds);
+        for (size_t parallel : {1, 3, 8})
+        {
+            options.parallel_chunks = parallel;
+            const size_t first = server.requests;
+            YahooStockData chunked = download_yahoo_data("TEST", start, end, options);
+            const std::string name = std::string(interval_name(interval)) + " bars over " + std::to_string(parallel) + " parallel chunks";
+            check(server.requests - first == chunks, name + " send one request per chunk");
+            check(!whole.date.empty() && same_bars(whole, chunked), name + " match a single request");
+            check(stitched(chunked), name + " are ordered without duplicates");
+            check(chunked.symbol == "TEST" && chunked.interval == interval, name + " keep the symbol and interval");
+        }
+    }
+    void failed_chunk(FakeYahoo &server)
+    {
+        DownloadOptions options;
+        options.host = server.host();
+        options.chunk_seconds = 10 * 86400;
+        options.parallel_chunks = 2;
+        const std::time_t start = 1700006400;
+        FakeYahoo::fail_period = start + 30 * 86400;
+        bool thrown = false;
+        try
+        {
+            download_yahoo_data("FAIL", start, start + 100 * 86400, options);
+        }
+        catch (const DownloadError &e)
+        {
+            thrown = e.http_code == 500;
+        }
+        check(thrown, "a failed chunk fails the download with its DownloadError");
+        FakeYahoo::fail_period = -1;
+    }
+    void retry_after(FakeYahoo &server)
+    {
+        DownloadOptions options;
+        options.host = server.host();
+        bool thrown = false;
+        try
+        {
+            download_yahoo_data("THROTTLED", 1700006400, 1700006400 + 10 * 86400, options);
+        }
+        catch (const DownloadError &e)
+        {
+            thrown = e.http_code == 429 && e.retry_after == 7;
+        }
+        check(thrown, "a 429 is reported with its Retry-After");
+    }
+}
+int main()
+{
+    FakeYahoo server;
+    // Midnight UTC, so chunk boundaries fall on bars returned by both neighbouring chunks
+    const std::time_t start = 1700006400;
+    chunked_matches_whole(server, BarInterval::OneDay, start, start + 365 * 86400, 30 * 86400);
+    // A last chunk shorter than the others and boundaries inside sessions
+    chunked_matches_whole(server, BarInterval::OneHour, start + 3600, start + 100 * 86400 + 7200, 7 * 86400 + 5 * 3600);
+    failed_chunk(server);
+    retry_after(server);
+    if (failures > 0)
+    {
+        std::cerr << failures << " checks failed\n";
+        return 1;
+    }
+    std::cout << "download_data_test passed\n";
+    return 0;
+}
@@ -0,0 +1,309 @@
+#include "../include/data/download_scheduler.hpp"
+#include <map>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <iostream>
+#include <stdexcept>
+using namespace portfolio_optimizer::data;
+namespace
+{
+    typedef std::chrono::steady_clock Clock;
+    size_t failures = 0;
+    void check(const bool condition, const std::string &message)
+    {
+        if (!condition)
+        {
+            std::cerr << "FAILED: " << message << "\n";
+            failures++;
+        }
+    }
+    std::vector<DownloadJob> make_jobs(const size_t count, const std::string &host = "")
+    {
+        std::vector<DownloadJob> jobs(count);
+        for (size_t i = 0; i < count; i++)
+        {
+            jobs[i].symbol = std::to_string(i);
+            jobs[i].symbol.insert(jobs[i].symbol.begin(), 'S');
+            jobs[i].start = 0;
+            jobs[i].end = 86400;
+            jobs[i].host = host;
+        }
+        return jobs;
+    }
+    YahooStockData one_bar(const DownloadJob &job)
+    {
+        YahooStockData data;
+        data.symbol = job.symbol;
+        data.date.push_back(job.start);
+        data.close.push_back(1);
+        return data;
+    }
+    // Fast, deterministic retries with no congestion signal from latency
+    SchedulerOptions quiet_options()
+    {
+        SchedulerOptions options;
+        options.base_backoff = 0.001;
+        options.max_backoff = 0.001;
+        options.latency_threshold = 1e9;
+        options.seed = 7;
+        return options;
+    }
+    // Concurrent fetches never exceed the host's limit, and each host has its own
+    void concurrency_limit()
+    {
+        SchedulerOptions options = quiet_options();
+        options.initial_concurrency = 3;
+        options.max_concurrency = 3;
+        std::mutex mutex;
+        std::map<std::string, size_t> in_flight;
+        std::map<std::string, size_t> peak;
+        DownloadScheduler scheduler(options, [&](const DownloadJob &job, const DownloadOptions &download)
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                size_t &current = ++in_flight[download.host];
+                peak[download.host] = std::max(peak[download.host], current);
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                in_flight[download.host]--;
+            }
+            return one_bar(job);
+        });
+        std::vector<DownloadJob> jobs = make_jobs(24, "http://a");
+        std::vector<DownloadJob> other = make_jobs(24, "http://b");
+        jobs.insert(jobs.end(), other.begin(), other.end());
+        std::vector<DownloadResult> results = scheduler.run(jobs);
+        for (const DownloadResult &result : results)
+        {
+            check(result.success && result.attempts == 1 && result.data.date.size() == 1, "every job succeeds once");
+        }
+        check(peak["http://a"] == 3 && peak["http://b"] == 3, "each host runs up to its limit of 3, got " + std::to_string(peak["http://a"]) + " and " + std::to_string(peak["http://b"]));
+        for (const HostMetrics &metrics : scheduler.metrics())
+        {
+            check(metrics.peak_in_flight <= 3, "metrics report the peak within the limit");
+            check(metrics.requests == 24 && metrics.successes == 24, "metrics count every request of " + metrics.host);
+        }
+    }
+    // The limit grows by one per window of limit successes
+    void additive_increase()
+    {
+        SchedulerOptions options = quiet_options();
+        options.initial_concurrency = 2;
+        DownloadScheduler scheduler(options, [](const DownloadJob &job, const DownloadOptions &)
+                                    { return one_bar(job); });
+        scheduler.run(make_jobs(10));
+        // 2 successes raise it to 3, 3 more to 4, 4 more to 5, the 10th starts the next window
+        check(scheduler.metrics().front().concurrency_limit == 5, "10 successes from a limit of 2 reach 5, got " + std::to_string(scheduler.metrics().front().concurrency_limit));
+    }
+    // A burst of overload responses within one round trip halves the limit once, not once per response
+    void multiplicative_decrease()
+    {
+        SchedulerOptions options = quiet_options();
+        options.initial_concurrency = 8;
+        options.max_attempts = 1;
+        DownloadScheduler scheduler(options, [](const DownloadJob &, const DownloadOptions &) -> YahooStockData
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            throw DownloadError("overloaded", 503, 0, 0);
+        });
+        scheduler.run(make_jobs(4));
+        HostMetrics metrics = scheduler.metrics().front();
+        check(metrics.concurrency_limit == 4, "4 concurrent 503s halve the limit of 8 once, got " + std::to_string(metrics.concurrency_limit));
+        check(metrics.server_errors == 4, "the 503s are counted as server errors");
+
+        options.initial_concurrency = 1;
+        options.min_concurrency = 1;
+        DownloadScheduler floor(options, [](const DownloadJob &, const DownloadOptions &) -> YahooStockData
+                                { throw DownloadError("throttled", 429, 0, 0); });
+        floor.run(make_jobs(4));
+        check(floor.metrics().front().concurrency_limit == 1, "the limit does not drop below min_concurrency");
+        check(floor.metrics().front().throttled == 4, "the 429s are counted as throttled");
+    }
+    // With the default latency threshold, a fast rejection does not make later successes look congested
+    void fast_rejection()
+    {
+        SchedulerOptions options = quiet_options();
+        options.latency_threshold = SchedulerOptions().latency_threshold;
+        options.initial_concurrency = 2;
+        options.max_attempts = 2;
+        std::atomic<size_t> calls{0};
+        DownloadScheduler scheduler(options, [&](const DownloadJob &job, const DownloadOptions &) -> YahooStockData
+        {
+            if (calls++ == 0)
+            {
+                throw DownloadError("throttled", 429, 0, 0);
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+            return one_bar(job);
+        });
+        std::vector<DownloadResult> results = scheduler.run(make_jobs(12));
+        HostMetrics metrics = scheduler.metrics().front();
+        check(metrics.throttled == 1 && metrics.successes == 12, "the throttled job is retried and every job succeeds");
+        // Halved to 1 by the 429, then 12 successes grow it to about 5
+        check(metrics.concurrency_limit >= 3, "the limit grows after a fast 429, got " + std::to_string(metrics.concurrency_limit));
+        check(metrics.min_latency >= 0.005, "only successes are timed, min latency " + std::to_string(metrics.min_latency));
+    }
+    // A success much slower than the fastest one counts as congestion
+    void latency_decrease()
+    {
+        SchedulerOptions options = quiet_options();
+        options.latency_threshold = SchedulerOptions().latency_threshold;
+        options.initial_concurrency = 4;
+        options.max_concurrency = 4;
+        std::atomic<size_t> calls{0};
+        DownloadScheduler scheduler(options, [&](const DownloadJob &job, const DownloadOptions &)
+        {
+            // The fifth request starts once one of the first four is timed
+            std::this_thread::sleep_for(std::chrono::milliseconds(calls++ == 4 ? 200 : 5));
+            return one_bar(job);
+        });
+        scheduler.run(make_jobs(5));
+        check(scheduler.metrics().front().concurrency_limit == 2, "a slow success halves the limit of 4, got " + std::to_string(scheduler.metrics().front().concurrency_limit));
+    }
+    // 0, 408, 429 and 5xx are retried up to max_attempts, other codes and non-DownloadError exceptions are not
+    void retryable_codes()
+    {
+        SchedulerOptions options = quiet_options();
+        options.max_attempts = 3;
+        for (long code : {0L, 408L, 429L, 500L, 502L, 503L, 599L, 400L, 401L, 403L, 404L})
+        {
+            std::atomic<size_t> calls{0};
+            DownloadScheduler scheduler(options, [&](const DownloadJob &, const DownloadOptions &) -> YahooStockData
+            {
+                calls++;
+                // A transfer that never got a response carries a curl code instead
+                throw DownloadError("error", code, code == 0 ? 28 : 0, 0.002);
+            });
+            DownloadResult result = scheduler.run(make_jobs(1)).front();
+            const bool retryable = code == 0 || code == 408 || code == 429 || code >= 500;
+            const size_t expected = retryable ? 3 : 1;
+            check(!result.success && result.attempts == expected && calls == expected,
+                  "HTTP " + std::to_string(code) + " is tried " + std::to_string(expected) + " times, got " + std::to_string(result.attempts));
+            check(result.http_code == code && result.curl_code == (code == 0 ? 28 : 0) && result.retry_after == 0.002 && result.error == "error",
+                  "HTTP " + std::to_string(code) + " is reported in the result");
+        }
+        std::atomic<size_t> calls{0};
+        DownloadScheduler scheduler(options, [&](const DownloadJob &, const DownloadOptions &) -> YahooStockData
+        {
+            calls++;
+            throw std::runtime_error("Unknown symbol");
+        });
+        DownloadResult result = scheduler.run(make_jobs(1)).front();
+        check(!result.success && result.attempts == 1 && calls == 1, "other exceptions are permanent");
+
+        // A retried job succeeds and keeps its attempt count
+        std::atomic<size_t> attempts{0};
+        DownloadScheduler recovering(options, [&](const DownloadJob &job, const DownloadOptions &) -> YahooStockData
+        {
+            if (++attempts < 3)
+            {
+                throw DownloadError("unavailable", 503, 0, 0);
+            }
+            return one_bar(job);
+        });
+        result = recovering.run(make_jobs(1)).front();
+        check(result.success && result.attempts == 3 && result.http_code == 200 && result.error.empty(), "a job succeeding on its third attempt is reported as a success");
+    }
+    // Retries wait a jittered exponential backoff capped at max_backoff, or at least the server's Retry-After
+    void retry_delays()
+    {
+        SchedulerOptions options = quiet_options();
+        options.max_attempts = 2;
+        std::vector<Clock::time_point> calls;
+        DownloadScheduler scheduler(options, [&](const DownloadJob &job, const DownloadOptions &) -> YahooStockData
+        {
+            calls.push_back(Clock::now());
+            if (calls.size() == 1)
+            {
+                throw DownloadError("throttled", 429, 0, 0.3);
+            }
+            return one_bar(job);
+        });
+        DownloadResult result = scheduler.run(make_jobs(1)).front();
+        double waited = std::chrono::duration<double>(calls[1] - calls[0]).count();
+        check(result.success && result.attempts == 2, "the throttled job is retried");
+        check(waited >= 0.3, "the retry waits for Retry-After, waited " + std::to_string(waited));
+
+        options.base_backoff = 0.05;
+        options.max_backoff = 0.1;
+        options.max_attempts = 5;
+        calls.clear();
+        DownloadScheduler backing_off(options, [&](const DownloadJob &, const DownloadOptions &) -> YahooStockData
+        {
+            calls.push_back(Clock::now());
+            throw DownloadError("unavailable", 503, 0, 0);
+        });
+        backing_off.run(make_jobs(1));
+        check(calls.size() == 5, "the job is tried max_attempts times");
+        for (size_t i = 1; i < calls.size(); i++)
+        {
+            // Attempt i waits at most min(max_backoff, base_backoff * 2^(i - 1)), with room for scheduling
+            const double ceiling = std::min(options.max_backoff, options.base_backoff * static_cast<double>(1 << (i - 1)));
+            waited = std::chrono::duration<double>(calls[i] - calls[i - 1]).count();
+            check(waited <= ceiling + 0.05, "retry " + std::to_string(i) + " waits at most " + std::to_string(ceiling) + ", waited " + std::to_string(waited));
+        }
+    }
+    // With one request at a time the stalest symbol goes first, ties keep the job order
+    void staleness_order()
+    {
+        SchedulerOptions options = quiet_options();
+        options.initial_concurrency = 1;
+        options.max_concurrency = 1;
+        std::vector<std::string> order;
+        DownloadScheduler scheduler(options, [&](const DownloadJob &job, const DownloadOptions &)
+        {
+            order.push_back(job.symbol);
+            return one_bar(job);
+        });
+        std::vector<DownloadJob> jobs = make_jobs(6);
+        const std::time_t last_updated[] = {50, 10, 30, 20, 40, 10};
+        for (size_t i = 0; i < jobs.size(); i++)
+        {
+            jobs[i].last_updated = last_updated[i];
+        }
+        std::vector<DownloadResult> results = scheduler.run(jobs);
+        check(order == std::vector<std::string>({"S1", "S5", "S3", "S2", "S4", "S0"}), "jobs run stalest first");
+        for (size_t i = 0; i < jobs.size(); i++)
+        {
+            check(results[i].symbol == jobs[i].symbol, "results stay in job order");
+        }
+    }
+    void invalid_bounds()
+    {
+        SchedulerOptions options;
+        options.min_concurrency = 0;
+        bool thrown = false;
+        try
+        {
+            DownloadScheduler scheduler(options);
+        }
+        catch (const std::invalid_argument &)
+        {
+            thrown = true;
+        }
+        check(thrown, "min_concurrency of 0 is rejected");
+    }
+}
+int main()
+{
+    concurrency_limit();
+    additive_increase();
+    multiplicative_decrease();
+    fast_rejection();
+    latency_decrease();
+    retryable_codes();
+    retry_delays();
+    staleness_order();
+    invalid_bounds();
+    if (failures > 0)
+    {
+        std::cerr << failures << " checks failed\n";
+        return 1;
+    }
+    std::cout << "download_scheduler_test passed\n";
+    return 0;
+}
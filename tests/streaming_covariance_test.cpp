@@ -0,0 +1,167 @@
+#include "../include/optimization/streaming_covariance.hpp"
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <filesystem>
+using namespace portfolio_optimizer::optimization;
+namespace
+{
+    size_t failures = 0;
+    void check(const bool condition, const std::string &message)
+    {
+        if (!condition)
+        {
+            std::cerr << "FAILED: " << message << "\n";
+            failures++;
+        }
+    }
+    std::string temporary(const std::string &name)
+    {
+        return (std::filesystem::temp_directory_path() / name).string();
+    }
+    // Columns far from zero with small moves, the case where raw cross-products cancel
+    Matrix<double> make_returns(const size_t observations, const size_t assets)
+    {
+        std::mt19937 random(11);
+        std::normal_distribution<double> noise(0, 1e-3);
+        Matrix<double> returns(observations, assets);
+        for (size_t t = 0; t < observations; t++)
+        {
+            const double common = noise(random);
+            for (size_t i = 0; i < assets; i++)
+            {
+                returns(t, i) = 100 + static_cast<double>(i) + common * (1 + 0.1 * static_cast<double>(i % 5)) + noise(random);
+            }
+        }
+        return returns;
+    }
+    double relative_error(const StreamingCovariance &result, const Matrix<double> &returns)
+    {
+        const size_t observations = returns.rows;
+        const size_t assets = returns.cols;
+        std::vector<double> mean(assets, 0.0);
+        for (size_t t = 0; t < observations; t++)
+        {
+            for (size_t i = 0; i < assets; i++)
+            {
+                mean[i] += returns(t, i);
+            }
+        }
+        double error = 0;
+        for (size_t i = 0; i < assets; i++)
+        {
+            mean[i] /= static_cast<double>(observations);
+            error = std::max(error, std::abs(result.mean[i] - mean[i]) / std::abs(mean[i]));
+        }
+        // Two passes: deviations from the mean, then their cross-products
+        for (size_t i = 0; i < assets; i++)
+        {
+            for (size_t j = 0; j <= i; j++)
+            {
+                double sum = 0;
+                for (size_t t = 0; t < observations; t++)
+                {
+                    sum += (returns(t, i) - mean[i]) * (returns(t, j) - mean[j]);
+                }
+                const double expected = sum / static_cast<double>(observations - 1);
+                error = std::max(error, std::abs(result.covariance(i, j) - expected) / std::abs(expected));
+            }
+        }
+        return error;
+    }
+    void matches_two_pass()
+    {
+        const size_t observations = 1003;
+        const size_t assets = 70;
+        Matrix<double> returns = make_returns(observations, assets);
+        const std::string path = temporary("streaming_covariance_test.panel");
+        write_returns_panel(path, returns);
+        for (size_t block_rows : {0, 1, 64, 1003, 5000})
+        {
+            for (size_t threads : {1, 3})
+            {
+                StreamingCovarianceConfig config;
+                config.block_rows = block_rows;
+                config.threads = threads;
+                StreamingCovariance result = streaming_covariance(path, config);
+                const std::string name = std::to_string(block_rows) + " rows per block on " + std::to_string(threads) + " threads";
+                check(result.observations == observations && result.mean.size() == assets && result.covariance.rows == assets, name + " reports the panel's size");
+                const double error = relative_error(result, returns);
+                check(error < 1e-9, name + " matches a two-pass covariance, relative error " + std::to_string(error));
+            }
+        }
+        // A panel written one row at a time is the same panel
+        const std::string rows_path = temporary("streaming_covariance_test_rows.panel");
+        {
+            ReturnsPanelWriter writer(rows_path, assets);
+            for (size_t t = 0; t < observations; t++)
+            {
+                writer.append(returns.values() + t * assets);
+            }
+            writer.finish();
+            check(writer.count() == observations, "the writer counts appended rows");
+        }
+        check(relative_error(streaming_covariance(rows_path), returns) < 1e-9, "a panel written row by row matches a two-pass covariance");
+        std::remove(path.c_str());
+        std::remove(rows_path.c_str());
+    }
+    template <typename Exception>
+    bool throws(const std::string &path)
+    {
+        try
+        {
+            streaming_covariance(path);
+        }
+        catch (const Exception &)
+        {
+            return true;
+        }
+        return false;
+    }
+    void write_header(const std::string &path, const uint64_t assets, const uint64_t observations, const size_t values)
+    {
+        std::FILE *file = std::fopen(path.c_str(), "wb");
+        ReturnsPanelHeader header;
+        std::memcpy(header.magic, returns_panel_magic, sizeof(header.magic));
+        header.assets = assets;
+        header.observations = observations;
+        std::fwrite(&header, sizeof(header), 1, file);
+        std::vector<double> zeros(values, 0.0);
+        std::fwrite(zeros.data(), sizeof(double), zeros.size(), file);
+        std::fclose(file);
+    }
+    void rejects_bad_panels()
+    {
+        const std::string path = temporary("streaming_covariance_test_bad.panel");
+        write_header(path, 0, 10, 0);
+        check(throws<std::runtime_error>(path), "a panel without assets is rejected");
+        // 2^61 assets * 8 observations * 8 bytes wraps to 0
+        write_header(path, uint64_t(1) << 61, 8, 16);
+        check(throws<std::runtime_error>(path), "a header whose size overflows is rejected");
+        write_header(path, 4, 100, 40);
+        check(throws<std::runtime_error>(path), "a truncated panel is rejected");
+        write_header(path, 4, 1, 4);
+        check(throws<std::invalid_argument>(path), "a single observation is rejected");
+        std::FILE *file = std::fopen(path.c_str(), "wb");
+        std::fputs("not a panel at all", file);
+        std::fclose(file);
+        check(throws<std::runtime_error>(path), "a file without the magic is rejected");
+        std::remove(path.c_str());
+    }
+}
+int main()
+{
+    matches_two_pass();
+    rejects_bad_panels();
+    if (failures > 0)
+    {
+        std::cerr << failures << " checks failed\n";
+        return 1;
+    }
+    std::cout << "streaming_covariance_test passed\n";
+    return 0;
+}